@@ -6,7 +6,22 @@ g++-9 -std=c++14 -g3 ../tests/test_datasets.cpp -o test_datasets
 g++-9 -std=c++14 -g3 ../tests/test_decision_tree.cpp -o test_decision_tree
 g++-9 -std=c++14 -g3 ../tests/test_losses.cpp -o test_losses
 g++-9 -std=c++14 -g3 ../tests/test_random_forest.cpp -o test_random_forest
+g++-9 -std=c++14 -g3 ../tests/test_compiled_forest.cpp -o test_compiled_forest
+g++-9 -std=c++14 -g3 ../tests/test_code_generator.cpp -o test_code_generator -ldl
+g++-9 -std=c++14 -g3 ../tests/test_quantized_forest.cpp -o test_quantized_forest
+g++-9 -std=c++14 -g3 ../tests/test_prediction_cache.cpp -o test_prediction_cache
+g++-9 -std=c++14 -g3 -pthread ../tests/test_forest_handle.cpp -o test_forest_handle
+g++-9 -std=c++14 -g3 -pthread ../tests/test_prediction_server.cpp -o test_prediction_server
+g++-9 -std=c++14 -g3 -pthread ../tests/test_streaming_predictor.cpp -o test_streaming_predictor
+g++-9 -std=c++14 -g3 -pthread ../tests/test_lazy_forest.cpp -o test_lazy_forest
 
 # Speedup scripts
 g++-9 -std=c++14 -O0 ../speedup/rf_serial.cpp -o rf_serial
-g++-9 -std=c++14 -O0 -fopenmp ../speedup/rf_openmp.cpp -o rf_openmp
\ No newline at end of file
+g++-9 -std=c++14 -O0 -fopenmp ../speedup/rf_openmp.cpp -o rf_openmp
+
+# Tools
+g++-9 -std=c++14 -O2 ../tools/forest_codegen.cpp -o forest_codegen
+g++-9 -std=c++14 -O2 ../tools/forest_compile.cpp -o forest_compile
+g++-9 -std=c++14 -O2 -pthread ../tools/forest_server.cpp -o forest_server
+g++-9 -std=c++14 -O2 -pthread ../tools/forest_loadgen.cpp -o forest_loadgen
+g++-9 -std=c++14 -O2 -pthread ../tools/forest_score.cpp -o forest_score
@@ -0,0 +1,130 @@
+#include "code_generator.hpp"
+#include "random_forest.hpp"
+#include "decision_tree.hpp"
+#include "tree_node.hpp"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
+
+/**
+ * Generate standalone C++ source code for a fitted DecisionTree or RandomForest.
+ * Each tree becomes a function of nested if/else statements with literal thresholds and leaf values,
+ * and the model is exposed as two `extern "C"` functions (so it can be built as a shared object):
+ *    double <function_name>(const double* x);  // Prediction for one observation (features x[0],...).
+ *    void <function_name>_batch(const double* x, long n, long stride, double* out);  // n observations, stride doubles apart.
+ * Predictions are the same as DecisionTree::predict and RandomForest::predict (numbers are written with
+ * enough digits to be read back exactly, and regression sums are added in the same order).
+ **/
+
+static std::string cpp_literal(double value){
+    /** Write a double so that it is read back exactly (infinities and NaN are written as expressions). */
+    if (std::isnan(value)) {
+        return "std::numeric_limits<double>::quiet_NaN()";
+    }
+    if (std::isinf(value)) {
+        return (value>0) ? "HUGE_VAL" : "-HUGE_VAL";
+    }
+    std::ostringstream stream;
+    stream << std::setprecision(17) << value;
+    std::string literal = stream.str();
+    if (literal.find_first_of(".en")==std::string::npos) {
+        literal += ".0";  // Keep integral values as double literals.
+    }
+    return literal;
+}
+
+static void generate_node(std::ostringstream& code, TreeNode* node, const std::vector<double>& classes, int indent){
+    /** Write the subtree rooted at given node as nested if/else statements (leaves return value or class position). */
+    std::string spaces(4*indent, ' ');
+    if (node->isLeaf()) {
+        if (classes.size()==0) {
+            code << spaces << "return " << cpp_literal(node->getPrediction()) << ";\n";
+        } else {
+            int vote = std::lower_bound(classes.begin(), classes.end(), node->getPrediction()) - classes.begin();
+            code << spaces << "return " << vote << ";\n";
+        }
+    } else {
+        // Observations with value <= threshold go left (and missing values go right), as in DecisionTree::predict:
+        code << spaces << "if (x[" << node->getSplitFeature() << "] <= " << cpp_literal(node->getSplitThreshold()) << ") {\n";
+        generate_node(code, node->getLeft(), classes, indent+1);
+        code << spaces << "} else {\n";
+        generate_node(code, node->getRight(), classes, indent+1);
+        code << spaces << "}\n";
+    }
+}
+
+static std::string generate_model(const std::vector<TreeNode*>& roots, bool regression, const std::vector<double>& classes, bool single_tree, std::string function_name){
+    /** Write functions for each tree (given by its root node) and the aggregated prediction. */
+    std::ostringstream code;
+    code << "// Generated scoring code for a " << (single_tree ? "DecisionTree" : "RandomForest with "+std::to_string(roots.size())+" trees");
+    code << " (" << (regression ? "regression" : "classification") << ").\n";
+    code << "// Features are passed as x[0],...,x[num_features-1] (without the label column).\n\n";
+    code << "#include <cmath>\n";
+    code << "#include <limits>\n\n";
+    code << "namespace {\n\n";
+    for (int t = 0; t < roots.size(); t++)
+    {
+        code << "inline " << (regression ? "double" : "int") << " tree_" << t << "(const double* x) {\n";
+        generate_node(code, roots[t], regression ? std::vector<double>() : classes, 1);
+        code << "}\n\n";
+    }
+    if (!regression) {
+        code << "const double classes[" << classes.size() << "] = {";
+        for (int c = 0; c < classes.size(); c++)
+        {
+            code << ((c>0) ? ", " : "") << cpp_literal(classes[c]);
+        }
+        code << "};\n\n";
+    }
+    code << "}  // namespace\n\n";
+    code << "extern \"C\" double " << function_name << "(const double* x) {\n";
+    if (regression) {
+        if (single_tree) {
+            code << "    return tree_0(x);\n";
+        } else {
+            // Mean of tree predictions:
+            code << "    double sum = 0;\n";
+            for (int t = 0; t < roots.size(); t++)
+            {
+                code << "    sum += tree_" << t << "(x);\n";
+            }
+            code << "    return sum / " << roots.size() << ";\n";
+        }
+    } else {
+        // Majority vote, breaking ties in favor of smallest label:
+        code << "    int votes[" << classes.size() << "] = {0};\n";
+        for (int t = 0; t < roots.size(); t++)
+        {
+            code << "    votes[tree_" << t << "(x)] += 1;\n";
+        }
+        code << "    int best = 0;\n";
+        code << "    for (int c = 1; c < " << classes.size() << "; c++) {\n";
+        code << "        if (votes[c] > votes[best]) { best = c; }\n";
+        code << "    }\n";
+        code << "    return classes[best];\n";
+    }
+    code << "}\n\n";
+    code << "extern \"C\" void " << function_name << "_batch(const double* x, long n, long stride, double* out) {\n";
+    code << "    for (long i = 0; i < n; i++) {\n";
+    code << "        out[i] = " << function_name << "(x + i*stride);\n";
+    code << "    }\n";
+    code << "}\n";
+    return code.str();
+}
+
+std::string generate_cpp(const DecisionTree& tree, std::string function_name){
+    /** Generate C++ source code with the same predictions as DecisionTree::predict. */
+    assert (tree.isFitted());
+    std::vector<double> classes;
+    if (!tree.isRegressionTree())
+        classes = tree.getClasses();
+    return generate_model({tree.getRoot()}, tree.isRegressionTree(), classes, true, function_name);
+}
+
+std::string generate_cpp(const RandomForest& forest, std::string function_name){
+    /** Generate C++ source code with the same predictions as RandomForest::predict. */
+    assert (forest.isFitted());
+    return generate_model(forest.getRoots(), forest.isRegressionTree(), forest.getClasses(), false, function_name);
+}
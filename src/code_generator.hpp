@@ -0,0 +1,12 @@
+#ifndef CODE_GENERATOR_HPP
+#define CODE_GENERATOR_HPP
+
+#include "random_forest.hpp"
+#include "decision_tree.hpp"
+#include "tree_node.hpp"
+#include <string>
+
+std::string generate_cpp(const DecisionTree& tree, std::string function_name="predict");
+std::string generate_cpp(const RandomForest& forest, std::string function_name="predict");
+
+#endif
@@ -0,0 +1,936 @@
+#include "compiled_forest.hpp"
+#include "random_forest.hpp"
+#include "decision_tree.hpp"
+#include "tree_node.hpp"
+#include "datasets.hpp"
+#include <assert.h>
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
+#include <fstream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COMPILED_FOREST_X86
+#endif
+
+// Largest number of observations traversing a tree in lock-step:
+#define COMPILED_FOREST_MAX_GROUP_SIZE 64
+// Number of trees walked together by the single-observation prediction (a multiple of the widest SIMD kernel):
+#define COMPILED_FOREST_TREE_CHUNK 64
+// Largest depth read from a file (a complete tree of that depth has 2^depth leaves, indexed by int):
+#define COMPILED_FOREST_MAX_DEPTH 30
+
+/*
+ * SIMD KERNELS :
+ * Walk one observation down several trees at once: each lane holds the current node of one tree,
+ * features and thresholds are gathered from the node array, and a vector compare chooses the children.
+ * Leaves point to themselves, so lanes that reached a leaf stay there until every lane has.
+ * Positions are in units of 4 bytes (int) or 8 bytes (double), so nodes must be 32 bytes.
+ * (Masked forms of gathers and extracts are used with all lanes on, so no register starts undefined.)
+ */
+
+static_assert(sizeof(CompiledNode)==32, "SIMD kernels assume 32-byte nodes.");
+
+static int best_simd_width(){
+    /** Widest kernel supported by this CPU. */
+    #ifdef COMPILED_FOREST_X86
+    if (__builtin_cpu_supports("avx512f")) { return 16; }
+    if (__builtin_cpu_supports("avx2")) { return 8; }
+    #endif
+    return 1;
+}
+
+#ifdef COMPILED_FOREST_X86
+__attribute__((target("avx2")))
+static void walk_trees_avx2(const CompiledNode* nodes, const int* roots, const double* observation, int* leaves){
+    /** Leaves reached by one observation in 8 trees (AVX2). */
+    const int* ints = reinterpret_cast<const int*>(nodes);
+    const double* doubles = reinterpret_cast<const double*>(nodes);
+    const __m256i left_field = _mm256_set1_epi32(offsetof(CompiledNode, left)/4);
+    const __m256i feature_field = _mm256_set1_epi32(offsetof(CompiledNode, feature)/4);
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i all_lanes = _mm256_set1_epi32(-1);  // Gather masks (all lanes).
+    const __m256d all_doubles = _mm256_castsi256_pd(all_lanes);
+    __m256i positions = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(roots));
+    while (true)
+    {
+        __m256i int_positions = _mm256_slli_epi32(positions, 3);  // 8 ints per node.
+        __m256i features = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), ints, _mm256_add_epi32(int_positions, feature_field), all_lanes, 4);
+        __m256i double_positions = _mm256_slli_epi32(positions, 2);  // 4 doubles per node (threshold first).
+        __m256d thresholds_lo = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), doubles, _mm256_castsi256_si128(double_positions), all_doubles, 8);
+        __m256d thresholds_hi = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), doubles, _mm256_extracti128_si256(double_positions, 1), all_doubles, 8);
+        __m256d values_lo = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), observation, _mm256_castsi256_si128(features), all_doubles, 8);
+        __m256d values_hi = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), observation, _mm256_extracti128_si256(features, 1), all_doubles, 8);
+        // Lanes going left (value <= threshold; missing values go right):
+        int go_left = _mm256_movemask_pd(_mm256_cmp_pd(values_lo, thresholds_lo, _CMP_LE_OQ))
+                   | (_mm256_movemask_pd(_mm256_cmp_pd(values_hi, thresholds_hi, _CMP_LE_OQ)) << 4);
+        __m256i left_lanes = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(go_left), lane_bits), lane_bits);
+        // Right is stored after left: field left+1, minus one (all ones) for lanes going left:
+        __m256i fields = _mm256_add_epi32(_mm256_add_epi32(int_positions, left_field), _mm256_add_epi32(_mm256_set1_epi32(1), left_lanes));
+        __m256i next = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), ints, fields, all_lanes, 4);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(next, positions))==-1) { break; }
+        positions = next;
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(leaves), positions);
+}
+
+__attribute__((target("avx512f")))
+static void walk_trees_avx512(const CompiledNode* nodes, const int* roots, const double* observation, int* leaves){
+    /** Leaves reached by one observation in 16 trees (AVX-512). */
+    const int* ints = reinterpret_cast<const int*>(nodes);
+    const double* doubles = reinterpret_cast<const double*>(nodes);
+    const __m512i left_field = _mm512_set1_epi32(offsetof(CompiledNode, left)/4);
+    const __m512i feature_field = _mm512_set1_epi32(offsetof(CompiledNode, feature)/4);
+    const __m512i one = _mm512_set1_epi32(1);
+    __m512i positions = _mm512_loadu_si512(roots);
+    while (true)
+    {
+        __m512i int_positions = _mm512_maskz_slli_epi32(0xFFFF, positions, 3);  // 8 ints per node.
+        __m512i features = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF, _mm512_add_epi32(int_positions, feature_field), ints, 4);
+        __m512i double_positions = _mm512_maskz_slli_epi32(0xFFFF, positions, 2);  // 4 doubles per node (threshold first).
+        __m512d thresholds_lo = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, _mm512_maskz_extracti64x4_epi64(0xF, double_positions, 0), doubles, 8);
+        __m512d thresholds_hi = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, _mm512_maskz_extracti64x4_epi64(0xF, double_positions, 1), doubles, 8);
+        __m512d values_lo = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, _mm512_maskz_extracti64x4_epi64(0xF, features, 0), observation, 8);
+        __m512d values_hi = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, _mm512_maskz_extracti64x4_epi64(0xF, features, 1), observation, 8);
+        // Lanes going left (value <= threshold; missing values go right):
+        __mmask16 go_left = _mm512_cmp_pd_mask(values_lo, thresholds_lo, _CMP_LE_OQ)
+                         | (_mm512_cmp_pd_mask(values_hi, thresholds_hi, _CMP_LE_OQ) << 8);
+        // Right is stored after left: field left+1 for lanes going right:
+        __m512i fields = _mm512_add_epi32(int_positions, left_field);
+        fields = _mm512_mask_add_epi32(fields, _mm512_knot(go_left), fields, one);
+        __m512i next = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF, fields, ints, 4);
+        if (_mm512_cmpeq_epi32_mask(next, positions)==0xFFFF) { break; }
+        positions = next;
+    }
+    _mm512_storeu_si512(leaves, positions);
+}
+#endif
+
+// Constructors:
+CompiledForest::CompiledForest(const RandomForest& forest, std::string engine, int perfect_depth)
+{
+    /**
+     * Flatten the trees of a fitted RandomForest.
+     *    forest : Fitted RandomForest.
+     *    engine        : Prediction engine: "traversal" or "quickscorer" (see CompiledForest).
+     *    perfect_depth : Largest depth of trees stored as complete binary trees by the traversal engine (or -1 for none).
+     */
+    assert (forest.isFitted());
+    this->regression_ = forest.isRegressionTree();
+    this->num_features_ = forest.getDataFrame().width()-1;  // Number of columns, excluding label column.
+    this->classes_ = forest.getClasses();
+    this->block_size_ = 1024;
+    this->group_size_ = 16;
+    assert ( (perfect_depth>=-1) and (perfect_depth<=20) );  // Complete trees have 2^perfect_depth leaves.
+    this->perfect_depth_ = perfect_depth;
+    this->simd_width_ = best_simd_width();
+    for (TreeNode* root : forest.getRoots())
+    {
+        this->depths_.push_back(0);
+        this->roots_.push_back(this->compile_(root, 0));
+    }
+    this->compileEngine_(engine);
+}
+
+CompiledForest::CompiledForest(const DecisionTree& tree, std::string engine, int perfect_depth)
+{
+    /**
+     * Flatten a fitted DecisionTree (as a forest of one tree).
+     *    tree   : Fitted DecisionTree.
+     *    engine        : Prediction engine: "traversal" or "quickscorer" (see CompiledForest).
+     *    perfect_depth : Largest depth of trees stored as complete binary trees by the traversal engine (or -1 for none).
+     */
+    assert (tree.isFitted());
+    this->regression_ = tree.isRegressionTree();
+    this->num_features_ = tree.getDataFrame().width()-1;  // Number of columns, excluding label column.
+    if (!this->regression_)
+        this->classes_ = tree.getClasses();
+    this->block_size_ = 1024;
+    this->group_size_ = 16;
+    assert ( (perfect_depth>=-1) and (perfect_depth<=20) );  // Complete trees have 2^perfect_depth leaves.
+    this->perfect_depth_ = perfect_depth;
+    this->simd_width_ = best_simd_width();
+    this->depths_.push_back(0);
+    this->roots_.push_back(this->compile_(tree.getRoot(), 0));
+    this->compileEngine_(engine);
+}
+
+CompiledForest::CompiledForest()
+{
+    /** Empty forest (without trees). */
+    this->regression_ = false;
+    this->num_features_ = 0;
+    this->block_size_ = 1024;
+    this->group_size_ = 16;
+    this->perfect_depth_ = -1;
+    this->simd_width_ = best_simd_width();
+    this->engine_ = "traversal";
+}
+
+// Getters:
+int CompiledForest::getNumTrees() const
+{
+    /** Number of trees. */
+    return this->roots_.size();
+}
+
+int CompiledForest::getNumNodes() const
+{
+    /** Number of nodes in all trees. */
+    return this->nodes_.size();
+}
+
+int CompiledForest::getNumFeatures() const
+{
+    /** Number of features in dataset. */
+    return this->num_features_;
+}
+
+bool CompiledForest::isRegressionTree() const
+{
+    /** Type of forest (classification or regression). */
+    return this->regression_;
+}
+
+std::vector<double> CompiledForest::getClasses() const
+{
+    /** Sorted class labels (classification only). */
+    return this->classes_;
+}
+
+std::string CompiledForest::getEngine() const
+{
+    /** Prediction engine. */
+    return this->engine_;
+}
+
+int CompiledForest::getNumPerfectTrees() const
+{
+    /** Number of trees stored as complete binary trees. */
+    return std::count_if(this->perfect_offsets_.begin(), this->perfect_offsets_.end(), [](int offset) { return offset!=-1; });
+}
+
+int CompiledForest::getSimdWidth() const
+{
+    /** Number of trees walked at once by one observation (16 with AVX-512, 8 with AVX2, or 1). */
+    return this->simd_width_;
+}
+
+// Setters:
+void CompiledForest::setBlockSize(int block_size)
+{
+    /** Number of observations predicted together by all trees (small enough for their votes to stay in cache). */
+    assert (block_size>0);
+    this->block_size_ = block_size;
+}
+
+void CompiledForest::setGroupSize(int group_size)
+{
+    /** Number of observations traversing a tree in lock-step (enough to hide memory latency of each level). */
+    assert ( (group_size>0) and (group_size<=COMPILED_FOREST_MAX_GROUP_SIZE) );
+    this->group_size_ = group_size;
+}
+
+void CompiledForest::setSimdWidth(int simd_width)
+{
+    /** Number of trees walked at once by one observation (must be supported by this CPU). */
+    assert ( (simd_width==1) or (simd_width==8) or (simd_width==16) );
+    assert (simd_width<=best_simd_width());
+    this->simd_width_ = simd_width;
+}
+
+// Utilities:
+int CompiledForest::compile_(TreeNode* node, int depth)
+{
+    /**
+     * Append subtree rooted at given node in depth-first order, and return its position.
+     * The child that received more training rows is laid out next to its parent (left child on ties),
+     * so the most likely path through each tree is contiguous in memory.
+     */
+    assert (node!=nullptr);
+    int position = this->nodes_.size();
+    CompiledNode compiled;
+    compiled.value = node->getPrediction();
+    compiled.vote = -1;
+    if (!this->regression_) {
+        compiled.vote = std::lower_bound(this->classes_.begin(), this->classes_.end(), compiled.value) - this->classes_.begin();
+    }
+    if (node->isLeaf()) {
+        // Leaf points to itself, so that extra levels of a traversal stay here:
+        compiled.threshold = 0;
+        compiled.feature = 0;
+        compiled.left = position;
+        compiled.right = position;
+        this->nodes_.push_back(compiled);
+        this->depths_.back() = std::max(this->depths_.back(), depth);
+    } else {
+        compiled.threshold = node->getSplitThreshold();
+        compiled.feature = node->getSplitFeature();
+        this->nodes_.push_back(compiled);
+        // Children are appended after their parent, more frequent one first (vector may grow, so set positions by index):
+        int left, right;
+        if (node->getRight()->getWeight() > node->getLeft()->getWeight()) {
+            right = this->compile_(node->getRight(), depth+1);
+            left = this->compile_(node->getLeft(), depth+1);
+        } else {
+            left = this->compile_(node->getLeft(), depth+1);
+            right = this->compile_(node->getRight(), depth+1);
+        }
+        this->nodes_[position].left = left;
+        this->nodes_[position].right = right;
+    }
+    return position;
+}
+
+int CompiledForest::layout_(int position, const std::vector<double>& counts, std::vector<CompiledNode>& nodes) const
+{
+    /**
+     * Append subtree rooted at the node at given position to `nodes` in depth-first order, with the child
+     * visited more often (according to `counts`, one per current position) next to its parent
+     * (current order on ties), and return its new position.
+     */
+    const CompiledNode& node = this->nodes_[position];
+    int new_position = nodes.size();
+    nodes.push_back(node);
+    if (node.left==position) {
+        nodes[new_position].left = new_position;
+        nodes[new_position].right = new_position;
+        return new_position;
+    }
+    bool right_first = (counts[node.right] > counts[node.left]) or ( (counts[node.right]==counts[node.left]) and (node.right<node.left) );
+    int first = this->layout_(right_first ? node.right : node.left, counts, nodes);
+    int second = this->layout_(right_first ? node.left : node.right, counts, nodes);
+    nodes[new_position].left = right_first ? second : first;
+    nodes[new_position].right = right_first ? first : second;
+    return new_position;
+}
+
+void CompiledForest::compileEngine_(std::string engine)
+{
+    /** Check that the engine exists (and supports these trees), and build its tables. */
+    if (engine=="traversal") {
+        this->compilePerfect_();
+    } else if (engine=="quickscorer") {
+        this->compileQuickScorer_();
+    } else {
+        throw std::invalid_argument( "Received invalid prediction engine: "+engine );
+    }
+    this->engine_ = engine;
+}
+
+void CompiledForest::compileQuickScorer_()
+{
+    /**
+     * Number the leaves of each tree from left to right (bit i of a bitvector is leaf i), and give each split
+     * the bitvector of leaves that are still reachable when an observation goes right (all but its left subtree).
+     * ANDing the bitvectors of all splits that go right leaves the exit leaf as the lowest set bit.
+     */
+    std::vector<std::vector<std::pair<double,std::pair<int,uint64_t>>>> splits(this->num_features_);
+    this->qs_leaf_offsets_ = {0};
+    this->qs_leaves_ = {};
+    for (int t = 0; t < this->roots_.size(); t++)
+    {
+        // Depth-first (left before right) stack of nodes, with first leaf of each split remembered:
+        std::vector<int> stack = {this->roots_[t]};
+        std::vector<std::pair<int,int>> open_splits;  // (node, number of leaves before it).
+        int num_leaves = 0;
+        while (stack.size()>0)
+        {
+            int position = stack.back();
+            stack.pop_back();
+            const CompiledNode& node = this->nodes_[position];
+            if (node.left==position) {
+                if (num_leaves==64) {
+                    throw std::invalid_argument( "QuickScorer engine needs trees with at most 64 leaves (tree "+std::to_string(t)+" has more)." );
+                }
+                this->qs_leaves_.push_back(position);
+                num_leaves++;
+                // Close splits whose left subtree ends with this leaf (their right child is next on the stack):
+                while ( (open_splits.size()>0) and (stack.size()>0) and (this->nodes_[open_splits.back().first].right==stack.back()) )
+                {
+                    int split = open_splits.back().first;
+                    int first = open_splits.back().second;
+                    open_splits.pop_back();
+                    // Clear bits first,...,num_leaves-1 (leaves of the left subtree):
+                    uint64_t left_leaves = ( (num_leaves==64) ? ~uint64_t(0) : ((uint64_t(1)<<num_leaves)-1) ) & ~((uint64_t(1)<<first)-1);
+                    const CompiledNode& split_node = this->nodes_[split];
+                    splits[split_node.feature].push_back(std::make_pair(split_node.threshold, std::make_pair(t, ~left_leaves)));
+                }
+            } else {
+                open_splits.push_back(std::make_pair(position, num_leaves));
+                stack.push_back(node.right);
+                stack.push_back(node.left);
+            }
+        }
+        this->qs_leaf_offsets_.push_back(this->qs_leaves_.size());
+    }
+    // Sort splits of each feature by threshold:
+    this->qs_offsets_ = {0};
+    this->qs_thresholds_ = {};
+    this->qs_trees_ = {};
+    this->qs_masks_ = {};
+    for (int f = 0; f < this->num_features_; f++)
+    {
+        std::stable_sort(
+            splits[f].begin(), splits[f].end(),
+            [](const std::pair<double,std::pair<int,uint64_t>>& a, const std::pair<double,std::pair<int,uint64_t>>& b) { return a.first<b.first; }
+        );
+        for (const std::pair<double,std::pair<int,uint64_t>>& split : splits[f])
+        {
+            this->qs_thresholds_.push_back(split.first);
+            this->qs_trees_.push_back(split.second.first);
+            this->qs_masks_.push_back(split.second.second);
+        }
+        this->qs_offsets_.push_back(this->qs_thresholds_.size());
+    }
+}
+
+void CompiledForest::compilePerfect_()
+{
+    /**
+     * Store each tree with at most perfect_depth_ levels of splits as a complete binary tree of that depth.
+     * A leaf above the last level is padded with splits whose children all end at the same leaf,
+     * so whichever way an observation goes it gets the same prediction.
+     */
+    this->perfect_offsets_ = {};
+    this->perfect_leaf_offsets_ = {};
+    this->perfect_features_ = {};
+    this->perfect_thresholds_ = {};
+    this->perfect_leaves_ = {};
+    for (int t = 0; t < this->roots_.size(); t++)
+    {
+        int depth = this->depths_[t];
+        if (depth > this->perfect_depth_) {
+            this->perfect_offsets_.push_back(-1);
+            this->perfect_leaf_offsets_.push_back(-1);
+            continue;
+        }
+        int offset = this->perfect_features_.size();
+        int leaf_offset = this->perfect_leaves_.size();
+        this->perfect_offsets_.push_back(offset);
+        this->perfect_leaf_offsets_.push_back(leaf_offset);
+        this->perfect_features_.resize(offset+(1<<depth)-1);
+        this->perfect_thresholds_.resize(offset+(1<<depth)-1);
+        this->perfect_leaves_.resize(leaf_offset+(1<<depth));
+        this->compilePerfect_(this->roots_[t], 0, 0, depth, offset, leaf_offset);
+    }
+}
+
+void CompiledForest::compilePerfect_(int position, int heap_index, int level, int depth, int offset, int leaf_offset)
+{
+    /** Fill the complete subtree at given heap index (and level) with the subtree of the node at given position. */
+    const CompiledNode& node = this->nodes_[position];
+    if (level==depth) {
+        // Last level holds leaves (left to right):
+        assert (node.left==position);
+        this->perfect_leaves_[leaf_offset+heap_index-((1<<depth)-1)] = position;
+    } else {
+        this->perfect_features_[offset+heap_index] = node.feature;  // 0 for padding below a leaf.
+        this->perfect_thresholds_[offset+heap_index] = node.threshold;
+        // Leaves point to themselves, so padding repeats the leaf on both sides:
+        this->compilePerfect_(node.left, 2*heap_index+1, level+1, depth, offset, leaf_offset);
+        this->compilePerfect_(node.right, 2*heap_index+2, level+1, depth, offset, leaf_offset);
+    }
+}
+
+void CompiledForest::predictPerfectGroup_(int tree, const double* const* observations, int n, int* leaves) const
+{
+    /**
+     * Find the leaf reached by each of n observations in the given complete tree.
+     * Every observation takes exactly `depth` steps, choosing child 2i+1 (left) or 2i+2 (right) from the
+     * result of the comparison, so there are no branches that depend on the data.
+     */
+    assert (n<=COMPILED_FOREST_MAX_GROUP_SIZE);
+    int depth = this->depths_[tree];
+    const int* features = this->perfect_features_.data()+this->perfect_offsets_[tree];
+    const double* thresholds = this->perfect_thresholds_.data()+this->perfect_offsets_[tree];
+    int indices[COMPILED_FOREST_MAX_GROUP_SIZE];
+    for (int i = 0; i < n; i++)
+    {
+        indices[i] = 0;
+    }
+    for (int level = 0; level < depth; level++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            int k = indices[i];
+            indices[i] = 2*k + 1 + !( observations[i][features[k]] <= thresholds[k] );
+        }
+    }
+    // Heap indices of the last level start after the (2^depth-1) splits:
+    int first_leaf = (1<<depth)-1;
+    const int* tree_leaves = this->perfect_leaves_.data()+this->perfect_leaf_offsets_[tree];
+    for (int i = 0; i < n; i++)
+    {
+        leaves[i] = tree_leaves[indices[i]-first_leaf];
+    }
+}
+
+void CompiledForest::predictQuickScorer_(const double* const* observations, int n, double* sums) const
+{
+    /**
+     * Accumulate predictions of all trees for n observations into `sums` (as in predictBlock_).
+     * For each feature, splits are visited in increasing order of threshold until one sends the observation left
+     * (value <= threshold); every split before it sends the observation right, so its bitvector is ANDed in.
+     */
+    int width = this->regression_ ? 1 : this->classes_.size();
+    int num_trees = this->roots_.size();
+    // Bitvectors go to a buffer kept by each thread (only allocated the first time it needs to grow):
+    thread_local std::vector<uint64_t> leaves;
+    if (leaves.size()<num_trees) {
+        leaves.resize(num_trees);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        const double* observation = observations[i];
+        std::fill(leaves.begin(), leaves.begin()+num_trees, ~uint64_t(0));
+        for (int f = 0; f < this->num_features_; f++)
+        {
+            double value = observation[f];
+            int end = this->qs_offsets_[f+1];
+            // Missing values (NaN) go right at every split, as in traversal:
+            for (int j = this->qs_offsets_[f]; (j < end) and !(value <= this->qs_thresholds_[j]); j++)
+            {
+                leaves[this->qs_trees_[j]] &= this->qs_masks_[j];
+            }
+        }
+        // Exit leaf of each tree is its lowest remaining bit:
+        for (int t = 0; t < num_trees; t++)
+        {
+            const CompiledNode& leaf = this->nodes_[this->qs_leaves_[this->qs_leaf_offsets_[t]+__builtin_ctzll(leaves[t])]];
+            if (this->regression_) {
+                sums[i] += leaf.value;
+            } else {
+                sums[i*width+leaf.vote] += 1;
+            }
+        }
+    }
+}
+
+void CompiledForest::predictGroup_(int tree, const double* const* observations, int n, int* leaves) const
+{
+    /**
+     * Find the leaf reached by each of n observations in the given tree.
+     * All observations go down one level at a time (leaves point to themselves, so observations that already
+     * reached a leaf stay there), and the next node of each one is prefetched while the others are moved,
+     * so memory latency overlaps.
+     */
+    assert (n<=COMPILED_FOREST_MAX_GROUP_SIZE);
+    const CompiledNode* nodes = this->nodes_.data();
+    int positions[COMPILED_FOREST_MAX_GROUP_SIZE];
+    for (int i = 0; i < n; i++)
+    {
+        positions[i] = this->roots_[tree];
+    }
+    // Go down one level at a time, until every observation has reached a leaf (at most the depth of the tree):
+    int moved = n;
+    for (int level = 0; (level < this->depths_[tree]) and (moved > 0); level++)
+    {
+        moved = 0;
+        for (int i = 0; i < n; i++)
+        {
+            const CompiledNode& node = nodes[positions[i]];
+            // Select child without a branch (right is stored just after left):
+            int next = (&node.left)[ !( observations[i][node.feature] <= node.threshold ) ];
+            moved += (next!=positions[i]);
+            positions[i] = next;
+            __builtin_prefetch(&nodes[next]);
+        }
+    }
+    for (int i = 0; i < n; i++)
+    {
+        leaves[i] = positions[i];
+    }
+}
+
+void CompiledForest::predictBlock_(const double* const* observations, int n, double* sums) const
+{
+    /**
+     * Accumulate predictions of all trees for n observations into `sums`
+     * (regression: one sum per observation; classification: one vote count per observation and class).
+     */
+    if (this->engine_=="quickscorer") {
+        this->predictQuickScorer_(observations, n, sums);
+        return;
+    }
+    int width = this->regression_ ? 1 : this->classes_.size();
+    int leaves[COMPILED_FOREST_MAX_GROUP_SIZE];
+    for (int t = 0; t < this->roots_.size(); t++)
+    {
+        for (int start = 0; start < n; start += this->group_size_)
+        {
+            int group_size = std::min(this->group_size_, n-start);
+            if (this->perfect_offsets_[t]!=-1) {
+                this->predictPerfectGroup_(t, observations+start, group_size, leaves);
+            } else {
+                this->predictGroup_(t, observations+start, group_size, leaves);
+            }
+            for (int i = 0; i < group_size; i++)
+            {
+                const CompiledNode& leaf = this->nodes_[leaves[i]];
+                if (this->regression_) {
+                    sums[start+i] += leaf.value;
+                } else {
+                    sums[(start+i)*width+leaf.vote] += 1;
+                }
+            }
+        }
+    }
+}
+
+double CompiledForest::aggregate_(const double* sums) const
+{
+    /** Mean value (regression) or majority vote (classification, breaking ties in favor of smallest label). */
+    if (this->regression_) {
+        return sums[0] / this->roots_.size();
+    }
+    int best = 0;
+    for (int c = 1; c < this->classes_.size(); c++)
+    {
+        if (sums[c]>sums[best]) { best = c; }
+    }
+    return this->classes_[best];
+}
+
+void CompiledForest::profile(DataFrame* sample)
+{
+    /**
+     * Lay out the nodes of each tree again according to how often a sample of observations (e.g. production inputs)
+     * visits them, instead of the number of training rows: the more frequent child of each split is placed next to it.
+     * Predictions do not change.
+     */
+    assert ( (sample->width()==this->num_features_) or (sample->width()==this->num_features_+1) );
+    // Count visits of each node:
+    std::vector<double> counts(this->nodes_.size(), 0.0);
+    for (int j = 0; j < sample->length(); j++)
+    {
+        const double* observation = sample->row(j)->data();
+        for (int t = 0; t < this->roots_.size(); t++)
+        {
+            int position = this->roots_[t];
+            counts[position] += 1;
+            while (this->nodes_[position].left!=position)
+            {
+                const CompiledNode& node = this->nodes_[position];
+                position = ( observation[node.feature] <= node.threshold ) ? node.left : node.right;
+                counts[position] += 1;
+            }
+        }
+    }
+    // Copy trees in the new order, then rebuild the tables of the engine (they refer to node positions):
+    std::vector<CompiledNode> nodes;
+    nodes.reserve(this->nodes_.size());
+    std::vector<int> roots;
+    for (int root : this->roots_)
+    {
+        roots.push_back(this->layout_(root, counts, nodes));
+    }
+    this->nodes_ = nodes;
+    this->roots_ = roots;
+    this->compileEngine_(this->engine_);
+}
+
+double CompiledForest::predictTree(int tree, const double* observation) const
+{
+    /** Prediction of one tree for a single observation. */
+    assert ( (tree>=0) and (tree<this->roots_.size()) );
+    int position = this->roots_[tree];
+    while (this->nodes_[position].left!=position)
+    {
+        const CompiledNode& node = this->nodes_[position];
+        position = ( observation[node.feature] <= node.threshold ) ? node.left : node.right;
+    }
+    return this->nodes_[position].value;
+}
+
+void CompiledForest::predictTrees_(const double* observation, int first, int count, int* leaves) const
+{
+    /** Find the leaf reached by one observation in trees first,...,first+count-1, walking simd_width_ trees at once. */
+    const int* roots = this->roots_.data()+first;
+    int t = 0;
+    #ifdef COMPILED_FOREST_X86
+    if (this->simd_width_==16) {
+        for (; t+16 <= count; t += 16)
+        {
+            walk_trees_avx512(this->nodes_.data(), roots+t, observation, leaves+t);
+        }
+    }
+    if (this->simd_width_>=8) {
+        for (; t+8 <= count; t += 8)
+        {
+            walk_trees_avx2(this->nodes_.data(), roots+t, observation, leaves+t);
+        }
+    }
+    #endif
+    // Remaining trees (or all trees, without SIMD):
+    for (; t < count; t++)
+    {
+        int position = roots[t];
+        while (this->nodes_[position].left!=position)
+        {
+            const CompiledNode& node = this->nodes_[position];
+            position = ( observation[node.feature] <= node.threshold ) ? node.left : node.right;
+        }
+        leaves[t] = position;
+    }
+}
+
+double CompiledForest::predict(const double* observation) const
+{
+    /** Prediction of the forest for a single observation (without allocating memory, once each thread has its buffer). */
+    assert (this->roots_.size()>0);
+    int width = this->regression_ ? 1 : this->classes_.size();
+    // Votes go to a buffer kept by each thread (only allocated the first time it needs to grow):
+    thread_local std::vector<double> sums;
+    if (sums.size()<width) {
+        sums.resize(width);
+    }
+    std::fill(sums.begin(), sums.begin()+width, 0.0);
+    if (this->engine_=="quickscorer") {
+        this->predictBlock_(&observation, 1, sums.data());
+        return this->aggregate_(sums.data());
+    }
+    // Walk trees in chunks (several at once), then add up leaves in tree order:
+    int num_trees = this->roots_.size();
+    int leaves[COMPILED_FOREST_TREE_CHUNK];
+    for (int first = 0; first < num_trees; first += COMPILED_FOREST_TREE_CHUNK)
+    {
+        int count = std::min(COMPILED_FOREST_TREE_CHUNK, num_trees-first);
+        this->predictTrees_(observation, first, count, leaves);
+        for (int t = 0; t < count; t++)
+        {
+            const CompiledNode& leaf = this->nodes_[leaves[t]];
+            if (this->regression_) {
+                sums[0] += leaf.value;
+            } else {
+                sums[leaf.vote] += 1;
+            }
+        }
+    }
+    return this->aggregate_(sums.data());
+}
+
+DataVector CompiledForest::predict(DataFrame* testdata) const
+{
+    /**
+     * Perform prediction on blocks of observations and collect a vector of predictions
+     * (same predictions as RandomForest::predict).
+     */
+    assert (this->roots_.size()>0);
+    // Make sure dataframe has the correct number of features (or one extra column with labels).
+    assert ( (testdata->width()==this->num_features_) or (testdata->width()==this->num_features_+1) );
+    int num_rows = testdata->length();
+    int width = this->regression_ ? 1 : this->classes_.size();
+    std::vector<const double*> observations(num_rows);
+    for (int j = 0; j < num_rows; j++)
+    {
+        observations[j] = testdata->row(j)->data();
+    }
+    std::vector<double> sums(num_rows*width, 0.0);
+    int num_blocks = (num_rows+this->block_size_-1)/this->block_size_;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int b = 0; b < num_blocks; b++)
+    {
+        int start = b*this->block_size_;
+        int end = std::min(start+this->block_size_, num_rows);
+        this->predictBlock_(observations.data()+start, end-start, sums.data()+start*width);
+    }
+    std::vector<double> predictions(num_rows);
+    for (int j = 0; j < num_rows; j++)
+    {
+        predictions[j] = this->aggregate_(sums.data()+j*width);
+    }
+    return DataVector(predictions, false);  // is_row=false.
+}
+
+void CompiledForest::predict(const double* data, size_t num_rows, size_t num_features, size_t row_stride, double* output) const
+{
+    /**
+     * Perform prediction on each row of an external row-major buffer, without copying it:
+     * feature f of row r is data[r*row_stride+f] (row_stride>=num_features, e.g. to skip a label column).
+     * Predictions are written to output[0],...,output[num_rows-1].
+     */
+    assert (this->roots_.size()>0);
+    assert ( (num_features==this->num_features_) or (num_features==this->num_features_+1) );
+    assert (row_stride>=num_features);
+    int width = this->regression_ ? 1 : this->classes_.size();
+    int num_blocks = (num_rows+this->block_size_-1)/this->block_size_;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int b = 0; b < num_blocks; b++)
+    {
+        size_t start = size_t(b)*this->block_size_;
+        int n = std::min(start+this->block_size_, num_rows) - start;
+        std::vector<const double*> observations(n);
+        for (int i = 0; i < n; i++)
+        {
+            observations[i] = data+(start+i)*row_stride;
+        }
+        std::vector<double> sums(n*width, 0.0);
+        this->predictBlock_(observations.data(), n, sums.data());
+        for (int i = 0; i < n; i++)
+        {
+            output[start+i] = this->aggregate_(sums.data()+i*width);
+        }
+    }
+}
+
+// Serialization:
+
+// First bytes of a saved CompiledForest (name and format version):
+static const char COMPILED_FOREST_MAGIC[8] = {'C','F','O','R','E','S','T','1'};
+
+template <typename T>
+static void write_vector(std::ofstream& file, const std::vector<T>& values){
+    /** Write the length of a vector followed by its values (as raw bytes). */
+    int64_t size = values.size();
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(reinterpret_cast<const char*>(values.data()), size*sizeof(T));
+}
+
+template <typename T>
+static std::vector<T> read_vector(std::ifstream& file){
+    /** Read a vector written by write_vector. */
+    int64_t size = -1;
+    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if ( (!file) or (size<0) ) {
+        throw std::runtime_error( "Truncated or corrupted CompiledForest file." );
+    }
+    std::vector<T> values(size);
+    file.read(reinterpret_cast<char*>(values.data()), size*sizeof(T));
+    if (!file) {
+        throw std::runtime_error( "Truncated or corrupted CompiledForest file." );
+    }
+    return values;
+}
+
+void CompiledForest::save(std::string filename) const
+{
+    /**
+     * Write the forest to a binary file (nodes, trees and options; engine tables are rebuilt by load).
+     * Files are meant to be read on the same kind of machine (native byte order).
+     */
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error( "Could not open file for writing: "+filename );
+    }
+    file.write(COMPILED_FOREST_MAGIC, sizeof(COMPILED_FOREST_MAGIC));
+    std::vector<int> options = {this->regression_, this->num_features_, this->block_size_, this->group_size_, this->perfect_depth_};
+    write_vector(file, options);
+    write_vector(file, std::vector<char>(this->engine_.begin(), this->engine_.end()));
+    write_vector(file, this->classes_);
+    write_vector(file, this->roots_);
+    write_vector(file, this->depths_);
+    write_vector(file, this->nodes_);
+    if (!file) {
+        throw std::runtime_error( "Could not write file: "+filename );
+    }
+}
+
+CompiledForest CompiledForest::load(std::string filename)
+{
+    /** Read a forest written by save (predictions are the same as those of the saved forest). */
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error( "Could not open file for reading: "+filename );
+    }
+    char magic[sizeof(COMPILED_FOREST_MAGIC)];
+    file.read(magic, sizeof(magic));
+    if ( (!file) or (!std::equal(magic, magic+sizeof(magic), COMPILED_FOREST_MAGIC)) ) {
+        throw std::runtime_error( "Not a CompiledForest file: "+filename );
+    }
+    CompiledForest forest;
+    std::vector<int> options = read_vector<int>(file);
+    if (options.size()!=5) {
+        throw std::runtime_error( "Truncated or corrupted CompiledForest file." );
+    }
+    forest.regression_ = options[0];
+    forest.num_features_ = options[1];
+    forest.block_size_ = options[2];
+    forest.group_size_ = options[3];
+    forest.perfect_depth_ = options[4];
+    std::vector<char> engine = read_vector<char>(file);
+    forest.classes_ = read_vector<double>(file);
+    forest.roots_ = read_vector<int>(file);
+    forest.depths_ = read_vector<int>(file);
+    forest.nodes_ = read_vector<CompiledNode>(file);
+    // Check that every position is inside the forest (so prediction cannot read outside of it), that children of a split
+    // come after it (so prediction cannot loop forever), and that depths fit complete trees (of at most 2^30 leaves):
+    int num_nodes = forest.nodes_.size();
+    bool valid = (forest.depths_.size()==forest.roots_.size()) and (forest.regression_ or (forest.classes_.size()>0));
+    valid = valid and (forest.perfect_depth_>=-1) and (forest.perfect_depth_<=20);
+    for (int root : forest.roots_)
+    {
+        valid = valid and (root>=0) and (root<num_nodes);
+    }
+    for (int depth : forest.depths_)
+    {
+        valid = valid and (depth>=0) and (depth<=COMPILED_FOREST_MAX_DEPTH);
+    }
+    for (int position = 0; position < num_nodes; position++)
+    {
+        const CompiledNode& node = forest.nodes_[position];
+        valid = valid and (node.left<num_nodes) and (node.right<num_nodes);
+        valid = valid and ( ( (node.left==position) and (node.right==position) ) or ( (node.left>position) and (node.right>position) ) );
+        valid = valid and (node.feature>=0) and (node.feature<std::max(forest.num_features_, 1));
+        valid = valid and (forest.regression_ or ( (node.vote>=0) and (node.vote<forest.classes_.size()) ));
+    }
+    if (!valid) {
+        throw std::runtime_error( "Truncated or corrupted CompiledForest file." );
+    }
+    forest.compileEngine_(std::string(engine.begin(), engine.end()));
+    return forest;
+}
+
+// First bytes of a CompiledForest saved with a per-tree offset index:
+static const char COMPILED_FOREST_INDEXED_MAGIC[8] = {'C','F','O','R','E','S','T','2'};
+
+void CompiledForest::saveIndexed(std::string filename) const
+{
+    /**
+     * Write the forest to a binary file where each tree can be read on its own (see LazyForest):
+     *    magic (8 bytes), header (int64: regression, number of features, number of trees, number of classes),
+     *    sorted class labels (double), index (int64: offset in file and number of nodes of each tree),
+     *    then the nodes of each tree, with positions relative to the first node of the tree (its root).
+     * Every section is a multiple of 8 bytes, so trees are aligned when the file is mapped in memory.
+     * Engine and options are not saved (trees are walked one at a time).
+     */
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error( "Could not open file for writing: "+filename );
+    }
+    int num_trees = this->roots_.size();
+    file.write(COMPILED_FOREST_INDEXED_MAGIC, sizeof(COMPILED_FOREST_INDEXED_MAGIC));
+    std::vector<int64_t> header = {this->regression_, this->num_features_, num_trees, (int64_t)this->classes_.size()};
+    file.write(reinterpret_cast<const char*>(header.data()), header.size()*sizeof(int64_t));
+    file.write(reinterpret_cast<const char*>(this->classes_.data()), this->classes_.size()*sizeof(double));
+    // Trees are laid out one after the other in depth-first order, so each one ends where the next one starts:
+    std::vector<int64_t> index(2*num_trees);
+    int64_t offset = sizeof(COMPILED_FOREST_INDEXED_MAGIC) + (header.size()+this->classes_.size()+index.size())*sizeof(int64_t);
+    for (int t = 0; t < num_trees; t++)
+    {
+        int end = (t+1<num_trees) ? this->roots_[t+1] : this->nodes_.size();
+        index[2*t] = offset;
+        index[2*t+1] = end - this->roots_[t];
+        offset += index[2*t+1]*sizeof(CompiledNode);
+    }
+    file.write(reinterpret_cast<const char*>(index.data()), index.size()*sizeof(int64_t));
+    for (int t = 0; t < num_trees; t++)
+    {
+        int root = this->roots_[t];
+        std::vector<CompiledNode> nodes(this->nodes_.begin()+root, this->nodes_.begin()+root+index[2*t+1]);
+        for (CompiledNode& node : nodes)
+        {
+            assert ( (node.left>=root) and (node.right>=root) );
+            node.left -= root;
+            node.right -= root;
+        }
+        file.write(reinterpret_cast<const char*>(nodes.data()), nodes.size()*sizeof(CompiledNode));
+    }
+    if (!file) {
+        throw std::runtime_error( "Could not write file: "+filename );
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef COMPILED_FOREST_HPP
+#define COMPILED_FOREST_HPP
+
+#include "random_forest.hpp"
+#include "decision_tree.hpp"
+#include "tree_node.hpp"
+#include "datasets.hpp"
+#include <cstdint>
+
+struct CompiledNode
+{
+    /**
+     * A node of a CompiledForest (stored by value in one array for all trees).
+     * Leaves point to themselves on both sides, so a traversal can run past a leaf without branching.
+     * */
+    double threshold;  // Numerical splitting threshold (observations with value <= threshold go left).
+    double value;  // Prediction at this node (mean value or majority class of its training data).
+    int feature;  // Index of splitting column (0 for leaves).
+    int left;  // Position of left child (or of this node, for leaves).
+    int right;  // Position of right child (or of this node, for leaves); must follow left.
+    int vote;  // Position of value in sorted class labels (classification leaves only).
+};
+
+class CompiledForest
+{
+    /**
+     * A fitted RandomForest (or DecisionTree) flattened into a contiguous array of nodes, for fast prediction.
+     * Trees are laid out in depth-first order (more frequent child next to its parent) and are read-only after construction
+     * (except for profile, which lays them out again).
+     * Prediction engines:
+     *    "traversal"   : Groups of observations walk each tree in lock-step (any tree). Trees with at most
+     *                    perfect_depth levels of splits are padded into complete binary trees stored in heap order
+     *                    (children of split i at 2i+1 and 2i+2), and walked with index arithmetic only.
+     *    "quickscorer" : Exit leaves are found with bitwise AND over per-tree leaf bitvectors, scanning the
+     *                    sorted thresholds of each feature (trees with at most 64 leaves).
+     * */
+
+private:
+
+    // Attributes:
+    std::vector<CompiledNode> nodes_;  // Nodes of all trees.
+    std::vector<int> roots_;  // Position of the root of each tree.
+    std::vector<int> depths_;  // Number of splits on the longest path of each tree.
+    bool regression_;  // Use regression==false for a classification forest.
+    int num_features_;  // Number of features in dataset.
+    std::vector<double> classes_;  // Sorted class labels (classification only).
+    int block_size_;  // Number of observations predicted together by all trees.
+    int group_size_;  // Number of observations traversing a tree in lock-step.
+    std::string engine_;  // String indicating prediction engine ("traversal" or "quickscorer").
+    int simd_width_;  // Number of trees walked at once by one observation (16 with AVX-512, 8 with AVX2, or 1).
+    int perfect_depth_;  // Largest depth of trees stored as complete binary trees (traversal engine).
+    std::vector<int> perfect_offsets_;  // Complete trees: Position of first split of each tree (or -1 if not complete).
+    std::vector<int> perfect_leaf_offsets_;  // Complete trees: Position of first leaf of each tree (or -1 if not complete).
+    std::vector<int> perfect_features_;  // Complete trees: Splitting column of each split, in heap order.
+    std::vector<double> perfect_thresholds_;  // Complete trees: Splitting threshold of each split, in heap order.
+    std::vector<int> perfect_leaves_;  // Complete trees: Node of each leaf, left to right (2^depth per tree).
+    std::vector<int> qs_offsets_;  // QuickScorer: Position of first split of each feature (plus end).
+    std::vector<double> qs_thresholds_;  // QuickScorer: Thresholds of all splits, sorted within each feature.
+    std::vector<int> qs_trees_;  // QuickScorer: Tree of each split.
+    std::vector<uint64_t> qs_masks_;  // QuickScorer: Bitvector of leaves still reachable when the split goes right.
+    std::vector<int> qs_leaf_offsets_;  // QuickScorer: Position of first leaf of each tree (plus end).
+    std::vector<int> qs_leaves_;  // QuickScorer: Nodes of leaves of each tree (left to right).
+
+    // Utilities:
+    int compile_(TreeNode* node, int depth);  // Append subtree rooted at given node (returns its position).
+    int layout_(int position, const std::vector<double>& counts, std::vector<CompiledNode>& nodes) const;  // Copy subtree with more frequent children first.
+    void compileEngine_(std::string engine);  // Check engine and build its tables.
+    void compileQuickScorer_();  // Build leaf bitvectors and sorted thresholds.
+    void compilePerfect_();  // Pad shallow trees into complete binary trees.
+    void compilePerfect_(int position, int heap_index, int level, int depth, int offset, int leaf_offset);  // Fill a complete subtree.
+    void predictPerfectGroup_(int tree, const double* const* observations, int n, int* leaves) const;  // Index-arithmetic traversal of one complete tree.
+    void predictQuickScorer_(const double* const* observations, int n, double* sums) const;  // QuickScorer version of predictBlock_.
+    void predictGroup_(int tree, const double* const* observations, int n, int* leaves) const;  // Lock-step traversal of one tree.
+    void predictBlock_(const double* const* observations, int n, double* sums) const;  // Accumulate votes (or sums) of all trees for a block.
+    void predictTrees_(const double* observation, int first, int count, int* leaves) const;  // Leaf reached in a range of trees by one observation (SIMD across trees).
+    double aggregate_(const double* sums) const;  // Mean value or majority vote from accumulated sums (or votes).
+
+public:
+
+    // Constructors:
+    CompiledForest(const RandomForest& forest, std::string engine="traversal", int perfect_depth=8);
+    CompiledForest(const DecisionTree& tree, std::string engine="traversal", int perfect_depth=8);
+    CompiledForest();
+
+    // Getters:
+    int getNumTrees() const;  // Number of trees.
+    int getNumNodes() const;  // Number of nodes in all trees.
+    int getNumFeatures() const;  // Number of features in dataset.
+    bool isRegressionTree() const;  // Type of forest (classification or regression).
+    std::vector<double> getClasses() const;  // Sorted class labels (classification only).
+    std::string getEngine() const;  // Prediction engine.
+    int getNumPerfectTrees() const;  // Number of trees stored as complete binary trees.
+    int getSimdWidth() const;  // Number of trees walked at once by one observation.
+
+    // Setters:
+    void setBlockSize(int block_size);  // Number of observations predicted together by all trees.
+    void setGroupSize(int group_size);  // Number of observations traversing a tree in lock-step.
+    void setSimdWidth(int simd_width);  // Number of trees walked at once by one observation (16, 8 or 1, if supported).
+
+    // Utilities:
+    void profile(DataFrame* sample);  // Lay out nodes again by how often a sample of observations visits them.
+    double predictTree(int tree, const double* observation) const;  // Prediction of one tree for a single observation.
+    double predict(const double* observation) const;  // Prediction of the forest for a single observation.
+    DataVector predict(DataFrame* testdata) const;  // Perform prediction on each observation (in blocks and groups).
+    void predict(const double* data, size_t num_rows, size_t num_features, size_t row_stride, double* output) const;  // Predict rows of an external row-major buffer.
+
+    // Serialization:
+    void save(std::string filename) const;  // Write forest to a binary file.
+    static CompiledForest load(std::string filename);  // Read forest written by save.
+    void saveIndexed(std::string filename) const;  // Write forest with a per-tree offset index (read lazily by LazyForest).
+
+};
+
+#endif
@@ -69,6 +69,12 @@ std::vector<double> DataVector::vector() const
     return vector;
 }
 
+const double* DataVector::data() const
+{
+    /** Get a (read-only) pointer to the values (valid until the vector is modified). */
+    return this->values_.data();
+}
+
 double DataVector::min() const
 {
     /** Returns the min of the values in the vector. */
@@ -546,7 +552,8 @@ DataFrame DataFrame::copy(bool deep) const
     return new_frame;
 }
 
-DataFrame DataFrame::sample(int nrow, int seed, bool replace) const{
+std::vector<int> DataFrame::sample_rows(int nrow, int seed, bool replace) const{
+    /** Returns the indices of randomly sampled rows (in the order they are drawn). */
     // Set random seed for reproducibility if specified
     if (seed == -1){
         // obtain a random number from hardware
@@ -563,19 +570,17 @@ DataFrame DataFrame::sample(int nrow, int seed, bool replace) const{
     }else{
         assert(nrow > 0);
     }
-    // Create new empty DataFrame
-    DataFrame new_frame = DataFrame();
+    // Create new empty list of row indices
+    std::vector<int> rows;
     if (replace == true){
         // Seed the generator
         std::mt19937 eng(seed);
         // Draw row indices from uniform distribution
         std::uniform_int_distribution<> distr(0, this->length()-1);
-        // pull random rows (as pointers, not copies) with replacement until full
-        while (new_frame.length() < nrow){
+        // pull random row indices with replacement until full
+        while (rows.size() < nrow){
             // get random row index with replacement
-            int rand_row = distr(eng);
-            // get pointer to that row in original dataframe and store in bootstrap
-            new_frame.addRow(this->row(rand_row));
+            rows.push_back(distr(eng));
         }
     }else{
         // pre-allocate vector of row indices
@@ -588,11 +593,33 @@ DataFrame DataFrame::sample(int nrow, int seed, bool replace) const{
         for (int i = 0; i < this->length(); i++){
             std::swap(indices[i], indices[i+(std::rand() % (this->length()-i))]);
         }
-        // pull random rows (as pointers, not copies) until full
+        // pull random row indices until full
         for (int i = 0; i < nrow; i++){
-            new_frame.addRow(this->row(indices[i]));
+            rows.push_back(indices[i]);
         }
     }
+    return rows;
+}
+
+std::vector<int> DataFrame::sample_counts(int nrow, int seed, bool replace) const{
+    /**
+     * Returns the number of times each row is drawn in a random sample
+     * (the same sample as returned by sample() with the same arguments).
+     */
+    std::vector<int> counts(this->length(), 0);
+    for (int row : this->sample_rows(nrow, seed, replace)){
+        counts[row] += 1;
+    }
+    return counts;
+}
+
+DataFrame DataFrame::sample(int nrow, int seed, bool replace) const{
+    // Create new empty DataFrame
+    DataFrame new_frame = DataFrame();
+    // pull sampled rows (as pointers, not copies)
+    for (int row : this->sample_rows(nrow, seed, replace)){
+        new_frame.addRow(this->row(row));
+    }
     return new_frame;
 }
 
@@ -740,6 +767,302 @@ DataFrame::DataFrame(std::vector<std::vector<double>> matrix)
 }
 
 
+/*
+ * RANKED DATA FRAME - ACCESSORS :
+ */
+
+
+int RankedDataFrame::length() const
+{
+    /** Returns the number of rows in the frame. */
+    return this->length_;
+}
+
+int RankedDataFrame::width() const
+{
+    /** Returns the number of encoded columns in the frame. */
+    return this->width_;
+}
+
+int RankedDataFrame::num_ranks(int c) const
+{
+    /** Returns the number of unique values in given column. */
+    return this->table(c).size();
+}
+
+bool RankedDataFrame::is_compact(int c) const
+{
+    /** Checks if the ranks of given column are stored as 16-bit integers. */
+    assert ( (c>=0) and (c<this->width()) );
+    return (this->ranks32_[c].size()==0);
+}
+
+unsigned int RankedDataFrame::rank(int r, int c) const
+{
+    /** Get rank of value in given row and column. */
+    assert ( (r>=0) and (r<this->length()) );
+    if (this->is_compact(c)) {
+        return this->ranks16_[c][r];
+    } else {
+        return this->ranks32_[c][r];
+    }
+}
+
+double RankedDataFrame::value(int c, unsigned int rank) const
+{
+    /** Get value with given rank in given column. */
+    const std::vector<double>& table = this->table(c);
+    assert (rank<table.size());
+    return table[rank];
+}
+
+const std::vector<double>& RankedDataFrame::table(int c) const
+{
+    /** Get unique values of given column, in increasing order (indexed by rank). */
+    assert ( (c>=0) and (c<this->width()) );
+    return (*this->tables_)[c];
+}
+
+
+/*
+ * RANKED DATA FRAME - UTILITES :
+ */
+
+
+unsigned int RankedDataFrame::encode(int c, double value) const
+{
+    /**
+     * Returns the number of unique values in given column that are below the given value.
+     * This is the rank of any observed value, and for any value x and observed value t:
+     *   x <= t  if and only if  encode(x) <= rank(t).
+     */
+    const std::vector<double>& table = this->table(c);
+    return std::lower_bound(table.begin(), table.end(), value) - table.begin();
+}
+
+std::vector<unsigned int> RankedDataFrame::encode(DataVector *row) const
+{
+    /** Encode a row of new data (which may have extra columns, e.g. labels). */
+    assert (row->size()>=this->width());
+    std::vector<unsigned int> ranks(this->width());
+    for (int c = 0; c < this->width(); c++)
+    {
+        ranks[c] = this->encode(c, row->value(c));
+    }
+    return ranks;
+}
+
+std::vector<int> RankedDataFrame::sorted_rows(int c) const
+{
+    /** Returns row indices sorted by given column, using a counting sort on ranks (ties keep their order). */
+    std::vector<int> counts(this->num_ranks(c)+1, 0);
+    for (int r = 0; r < this->length(); r++)
+    {
+        counts[this->rank(r,c)+1] += 1;
+    }
+    // Prefix sums give the first position of each rank:
+    for (int k = 1; k < counts.size(); k++)
+    {
+        counts[k] += counts[k-1];
+    }
+    std::vector<int> rows(this->length());
+    for (int r = 0; r < this->length(); r++)
+    {
+        rows[ counts[this->rank(r,c)]++ ] = r;
+    }
+    return rows;
+}
+
+DataFrame RankedDataFrame::decode() const
+{
+    /** Returns a new DataFrame with the original values of the encoded columns. */
+    DataFrame new_frame = DataFrame();
+    for (int c = 0; c < this->width(); c++)
+    {
+        std::vector<double> col;
+        for (int r = 0; r < this->length(); r++)
+        {
+            col.push_back( this->value(c, this->rank(r,c)) );
+        }
+        new_frame.addCol(col);
+    }
+    return new_frame;
+}
+
+
+/*
+ * RANKED DATA FRAME - CONSTRUCTORS :
+ */
+
+
+RankedDataFrame::RankedDataFrame()
+{
+    this->length_ = 0;
+    this->width_ = 0;
+    this->tables_ = std::make_shared<const std::vector<std::vector<double>>>();
+}
+
+RankedDataFrame::RankedDataFrame(const DataFrame& dataframe, int num_columns)
+{
+    /**
+     * Encode the first num_columns of a DataFrame (or all columns if num_columns==-1).
+     * Columns with up to 65536 unique values use 16-bit ranks, others use 32-bit ranks.
+     */
+    assert ( (num_columns>=-1) and (num_columns<=dataframe.width()) );
+    this->length_ = dataframe.length();
+    this->width_ = (num_columns==-1) ? dataframe.width() : num_columns;
+    std::vector<std::vector<double>> tables;
+    for (int c = 0; c < this->width(); c++)
+    {
+        std::vector<double> col_vals = dataframe.col(c).vector();
+        // Build table of unique values:
+        std::vector<double> table = col_vals;
+        std::sort(table.begin(), table.end());
+        table.erase(std::unique(table.begin(), table.end()), table.end());
+        // Replace each value with its position in the table:
+        std::vector<uint16_t> ranks16;
+        std::vector<uint32_t> ranks32;
+        bool compact = (table.size()<=65536);
+        for (int r = 0; r < this->length(); r++)
+        {
+            uint32_t rank = std::lower_bound(table.begin(), table.end(), col_vals[r]) - table.begin();
+            if (compact) {
+                ranks16.push_back(rank);
+            } else {
+                ranks32.push_back(rank);
+            }
+        }
+        this->ranks16_.push_back(ranks16);
+        this->ranks32_.push_back(ranks32);
+        tables.push_back(table);
+    }
+    this->tables_ = std::make_shared<const std::vector<std::vector<double>>>(tables);
+}
+
+
+/*
+ * BINNED DATA FRAME - ACCESSORS :
+ */
+
+
+int BinnedDataFrame::length() const
+{
+    /** Returns the number of rows in the frame. */
+    return this->length_;
+}
+
+int BinnedDataFrame::width() const
+{
+    /** Returns the number of encoded columns in the frame. */
+    return this->width_;
+}
+
+int BinnedDataFrame::num_bins(int c) const
+{
+    /** Returns the number of bins in given column. */
+    return this->boundaries(c).size();
+}
+
+uint8_t BinnedDataFrame::bin(int r, int c) const
+{
+    /** Get bin code in given row and column. */
+    assert ( (r>=0) and (r<this->length()) );
+    assert ( (c>=0) and (c<this->width()) );
+    return this->codes_[c][r];
+}
+
+double BinnedDataFrame::upper(int c, int b) const
+{
+    /** Get upper boundary of given bin (the largest observed value in the bin). */
+    const std::vector<double>& uppers = this->boundaries(c);
+    assert ( (b>=0) and (b<uppers.size()) );
+    return uppers[b];
+}
+
+const std::vector<double>& BinnedDataFrame::boundaries(int c) const
+{
+    /** Get upper boundaries of all bins in given column, in increasing order. */
+    assert ( (c>=0) and (c<this->width()) );
+    return this->uppers_[c];
+}
+
+
+/*
+ * BINNED DATA FRAME - UTILITES :
+ */
+
+
+uint8_t BinnedDataFrame::encode(int c, double value) const
+{
+    /** Bin code of a (possibly unseen) value: the first bin whose upper boundary is not below it. */
+    const std::vector<double>& uppers = this->boundaries(c);
+    int b = std::lower_bound(uppers.begin(), uppers.end(), value) - uppers.begin();
+    // Values above the training range fall in the last bin (never used as a threshold):
+    return std::min(b, int(uppers.size())-1);
+}
+
+std::vector<uint8_t> BinnedDataFrame::encode(DataVector *row) const
+{
+    /** Encode a row of new data (which may have extra columns, e.g. labels). */
+    assert (row->size()>=this->width());
+    std::vector<uint8_t> codes(this->width());
+    for (int c = 0; c < this->width(); c++)
+    {
+        codes[c] = this->encode(c, row->value(c));
+    }
+    return codes;
+}
+
+/*
+ * BINNED DATA FRAME - CONSTRUCTORS :
+ */
+
+
+BinnedDataFrame::BinnedDataFrame()
+{
+    this->length_ = 0;
+    this->width_ = 0;
+}
+
+BinnedDataFrame::BinnedDataFrame(const DataFrame& dataframe, int num_columns, int max_bins)
+{
+    /**
+     * Encode the first num_columns of a DataFrame (or all columns if num_columns==-1).
+     * Columns with at most max_bins unique values get one bin per value (lossless);
+     * otherwise bin boundaries are taken at (roughly) equally spaced quantiles.
+     */
+    assert ( (num_columns>=-1) and (num_columns<=dataframe.width()) );
+    assert ( (max_bins>=2) and (max_bins<=256) );  // Codes are stored in 8 bits.
+    this->length_ = dataframe.length();
+    this->width_ = (num_columns==-1) ? dataframe.width() : num_columns;
+    for (int c = 0; c < this->width(); c++)
+    {
+        std::vector<double> col_vals = dataframe.col(c).vector();
+        std::vector<double> sorted_vals = col_vals;
+        std::sort(sorted_vals.begin(), sorted_vals.end());
+        std::vector<double> uppers = sorted_vals;
+        uppers.erase(std::unique(uppers.begin(), uppers.end()), uppers.end());
+        if (uppers.size()>max_bins) {
+            // Take upper boundaries at quantiles (skipping repeats, so heavy values get a bin to themselves):
+            uppers = {};
+            int n = sorted_vals.size();
+            for (int b = 1; b <= max_bins; b++)
+            {
+                double val = sorted_vals[ (long(b)*n - 1)/max_bins ];
+                if ( (uppers.size()==0) or (val>uppers.back()) ) { uppers.push_back(val); }
+            }
+        }
+        std::vector<uint8_t> codes(this->length());
+        for (int r = 0; r < this->length(); r++)
+        {
+            codes[r] = std::lower_bound(uppers.begin(), uppers.end(), col_vals[r]) - uppers.begin();
+        }
+        this->uppers_.push_back(uppers);
+        this->codes_.push_back(codes);
+    }
+}
+
+
 /*
  * DATA LOADER - ACCESSORS :
  */
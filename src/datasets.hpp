@@ -4,6 +4,8 @@
 #include <vector>
 #include <string>
 #include <random>
+#include <memory>
+#include <cstdint>
 
 class DataVector
 {
@@ -28,6 +30,7 @@ public:
     double value(int i) const;  // Get value in given position.
     double getValue(int i) const;  // Get value in given position.
     std::vector<double> vector() const;  // Get a copy of values as a vector of doubles.
+    const double* data() const;  // Get a (read-only) pointer to the values.
     double min() const;  // Returns the min of the values in the vector.
     double max() const;  // Returns the max of the values in the vector.
     double sum() const;  // Returns the sum of the values in the vector.
@@ -94,6 +97,8 @@ public:
     void addCol(DataVector col);  // Append the values each row in the lists.
     void addCol(std::vector<double> vector);  // Append the values to each row in the list.
     DataFrame sample(int nrow = -1, int seed = -1, bool replace = true) const; // Samples
+    std::vector<int> sample_rows(int nrow = -1, int seed = -1, bool replace = true) const; // Row indices of a sample.
+    std::vector<int> sample_counts(int nrow = -1, int seed = -1, bool replace = true) const; // Number of times each row is sampled.
     DataFrame copy(bool deep=false) const;  // Returns a copy of the DataFrame.
     DataFrame transpose() const;  // Returns a transposed copy of the DataFrame.
     std::vector<DataFrame> split(int split_column, double split_threshold, bool equal_goes_left=true) const;  // Returns a pair of frames (value above and below threshold in specified column).
@@ -110,6 +115,84 @@ public:
 
 };
 
+class RankedDataFrame
+{
+    /**
+     * A lossless integer encoding of the columns of a DataFrame:
+     * each value is replaced by its rank among the unique values of its column.
+     * Comparisons against observed values give the same result on ranks as on the values themselves.
+     * */
+
+private:
+
+    // Attributes:
+    int length_;  // Number of rows.
+    int width_;  // Number of encoded columns.
+    std::shared_ptr<const std::vector<std::vector<double>>> tables_;  // Unique values of each column in increasing order (rank -> value).
+    std::vector<std::vector<uint16_t>> ranks16_;  // Ranks of columns with at most 65536 unique values (empty otherwise).
+    std::vector<std::vector<uint32_t>> ranks32_;  // Ranks of columns with more unique values (empty otherwise).
+
+public:
+
+    // Accessors:
+    int length() const;  // Returns number of rows.
+    int width() const;  // Returns number of encoded columns.
+    int num_ranks(int c) const;  // Returns number of unique values in given column.
+    bool is_compact(int c) const;  // Checks if the ranks of given column are stored as 16-bit integers.
+    unsigned int rank(int r, int c) const;  // Get rank of value in given row and column.
+    double value(int c, unsigned int rank) const;  // Get value with given rank in given column.
+    const std::vector<double>& table(int c) const;  // Get unique values of given column (indexed by rank).
+
+    // Utilities:
+    unsigned int encode(int c, double value) const;  // Rank of a (possibly unseen) value: number of unique values below it.
+    std::vector<unsigned int> encode(DataVector *row) const;  // Encode a row of new data (e.g. at prediction time).
+    std::vector<int> sorted_rows(int c) const;  // Row indices sorted by given column (counting sort; ties keep their order).
+    DataFrame decode() const;  // Returns a DataFrame with the original values.
+
+    // Constructors:
+    RankedDataFrame();
+    RankedDataFrame(const DataFrame& dataframe, int num_columns=-1);  // Encode the first num_columns (or -1 for all).
+
+};
+
+class BinnedDataFrame
+{
+    /**
+     * A compact representation of the columns of a DataFrame:
+     * each value is replaced by an 8-bit bin code, with at most 256 bins per column chosen by quantiles.
+     * The upper boundary of each bin is an observed value, so for training data
+     * "code <= b" holds exactly when "value <= upper(c,b)".
+     * Read-only once built, so it can be shared by every tree (and thread) of a RandomForest.
+     * */
+
+private:
+
+    // Attributes:
+    int length_;  // Number of rows.
+    int width_;  // Number of encoded columns.
+    std::vector<std::vector<double>> uppers_;  // Upper boundary (largest value) of each bin, per column.
+    std::vector<std::vector<uint8_t>> codes_;  // Bin codes, stored column by column.
+
+public:
+
+    // Accessors:
+    int length() const;  // Returns number of rows.
+    int width() const;  // Returns number of encoded columns.
+    int num_bins(int c) const;  // Returns number of bins in given column.
+    uint8_t bin(int r, int c) const;  // Get bin code in given row and column.
+    double upper(int c, int b) const;  // Get upper boundary of given bin (an observed value).
+    const std::vector<double>& boundaries(int c) const;  // Get upper boundaries of all bins in given column.
+
+    // Utilities:
+    uint8_t encode(int c, double value) const;  // Bin code of a (possibly unseen) value.
+    std::vector<uint8_t> encode(DataVector *row) const;  // Encode a row of new data.
+
+    // Constructors:
+    BinnedDataFrame();
+    BinnedDataFrame(const DataFrame& dataframe, int num_columns=-1, int max_bins=256);  // Encode the first num_columns (or -1 for all).
+
+};
+
 class DataLoader
 {
     /**
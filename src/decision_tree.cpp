@@ -10,11 +10,16 @@
 #include <assert.h>
 #include <time.h>  // std::time.
 
+// Largest rounding difference between regression losses of a split computed in different ways, relative to the loss of the node:
+#define DECISION_TREE_LOSS_TOLERANCE 1e-9
+
 // Constructors:
 
 DecisionTree::DecisionTree(
     DataFrame dataframe, bool regression, std::string loss,
-    int mtry, int max_height, int max_leaves, int min_obs, double max_prop, int seed
+    int mtry, int max_height, int max_leaves, int min_obs, double max_prop, int seed,
+    std::string split_method, std::vector<int> sample_weights,
+    std::shared_ptr<const RankedDataFrame> ranked, std::shared_ptr<const BinnedDataFrame> binned
 )
 {
     /**
@@ -28,6 +33,15 @@ DecisionTree::DecisionTree(
      *    min_obs    : Stopping condition: minimum number of observations in a leaf (or -1 for no stopping on this condition).
      *    max_prop   : Stopping condition: maximum proportion of majority class in a leaf (or -1 for no stopping on this condition).
      *    seed       : Non-negative seed (for repeatable results), or -1 (for non-deterministic sequence).
+     *    split_method : Split search: "exact" (re-sort candidate values at every node)
+     *                   or "presorted" (rank-encode and counting-sort each feature once per tree,
+     *                   then partition the sorted rows at each split)
+     *                   or "histogram" (scan per-bin histograms of quantile-binned features; thresholds are bin boundaries).
+     *    sample_weights : Number of times each training row is counted (e.g. its multiplicity in a bootstrap sample),
+     *                     or empty to count each row once. Rows with zero weight are skipped entirely.
+     *    ranked     : Rank-encoded training data shared between trees (presorted only), or nullptr to encode it here.
+     *    binned     : Binned training data shared between trees (histogram only; rows are located by pointer),
+     *                 or nullptr to bin the training data of this tree.
     */
     // Check inputs:
     assert ((dataframe.length()>0) and dataframe.width()>0);  // Need at least one row and column (plus class column).
@@ -53,6 +67,10 @@ DecisionTree::DecisionTree(
             throw std::invalid_argument( "Received invalid loss method for classification tree: "+loss );
         }
     }
+    if ( (split_method!="exact") and (split_method!="presorted") and (split_method!="histogram") ) {
+        throw std::invalid_argument( "Received invalid split method: "+split_method );
+    }
+    assert ( (sample_weights.size()==0) or (sample_weights.size()==dataframe.length()) );  // One weight per row.
     // Set properties constructor from inputs:
     this->dataframe_ = dataframe;
     this->num_features_ = dataframe.width()-1;  // Number of columns, excluding label column.
@@ -64,15 +82,67 @@ DecisionTree::DecisionTree(
     this->min_obs_ = min_obs;
     this->max_prop_ = max_prop;
     this->meta_seed_ = seed;
+    this->split_method_ = split_method;
     // Initialize:
-    TreeNode *root = new TreeNode(this->dataframe_);
+    if (sample_weights.size()==0) { sample_weights = std::vector<int>(dataframe.length(), 1); }
+    this->sample_weights_ = sample_weights;
+    this->labels_ = this->dataframe_.col(-1).vector();
+    if (!this->isRegressionTree()) {
+        this->classes_ = LabelCounter(this->dataframe_.col(-1)).get_labels().vector();
+    }
+    // Root node holds every row with non-zero weight (each row once, however many times it is counted):
+    std::vector<int> rows;
+    DataFrame root_data = DataFrame();
+    for (int i = 0; i < this->dataframe_.length(); i++)
+    {
+        assert (this->sample_weights_[i]>=0);
+        if (this->sample_weights_[i]>0) {
+            rows.push_back(i);
+            root_data.addRow(this->dataframe_.row(i));
+        }
+    }
+    assert (rows.size()>0);  // Need at least one row with non-zero weight.
+    TreeNode *root = new TreeNode(root_data);
     this->root_ = root;
     this->num_leaves_ = 1;
     this->leaves_ = {this->root_};
     this->fitted_ = false;
     this->seed_gen = SeedGenerator(this->meta_seed_);
+    // Prepare data structures used by the split search:
+    std::vector<std::vector<int>> sorted_rows;
+    if (this->split_method_=="presorted") {
+        // Encode features as ranks (unless shared ranks were given) and sort them once:
+        if (ranked==nullptr) {
+            ranked = std::make_shared<const RankedDataFrame>(this->dataframe_, this->num_features_);
+        }
+        assert ( (ranked->length()==this->dataframe_.length()) and (ranked->width()==this->num_features_) );
+        this->ranked_ = ranked;
+        sorted_rows = this->presort();
+    } else if (this->split_method_=="histogram") {
+        // Bin features (unless shared binned data was given):
+        if (binned==nullptr) {
+            binned = std::make_shared<const BinnedDataFrame>(this->dataframe_, this->num_features_);
+        }
+        // Training row i is row i of the binned data (samples are given as sample weights, not as new frames):
+        if ( (binned->length()!=this->dataframe_.length()) or (binned->width()!=this->num_features_) ) {
+            throw std::invalid_argument( "Binned data must have one row per training row, and one column per feature." );
+        }
+        this->binned_ = binned;
+        if (!this->isRegressionTree()) {
+            for (int i = 0; i < this->labels_.size(); i++)
+            {
+                int class_id = std::lower_bound(this->classes_.begin(), this->classes_.end(), this->labels_[i]) - this->classes_.begin();
+                this->class_ids_.push_back(class_id);
+            }
+        }
+    }
     // Perform training:
-    fit_(this->root_);  // Fit recursively, beginning at root:
+    fit_(this->root_, rows, sorted_rows);  // Fit recursively, beginning at root:
+    // Release data structures used by the split search:
+    this->ranked_ = nullptr;
+    this->binned_ = nullptr;
+    this->class_ids_ = {};
+    this->labels_ = {};
     // Update list of leaves:
     this->leaves_ = this->root_->findLeaves();
     this->fitted_ = true;
@@ -140,6 +210,18 @@ DataFrame DecisionTree::getDataFrame() const
     return this->dataframe_;
 }
 
+std::vector<int> DecisionTree::getSampleWeights() const
+{
+    /** Get number of times each training row was counted (zero for rows left out, e.g. out-of-bag rows). */
+    return this->sample_weights_;
+}
+
+std::vector<double> DecisionTree::getClasses() const
+{
+    /** Sorted class labels of training data (classification only). */
+    return this->classes_;
+}
+
 std::string DecisionTree::to_string() const
 {
     /** Return the DecisionTree as a string. */
@@ -187,7 +269,7 @@ std::string DecisionTree::to_string() const
         }
         if (node->hasSplit()) {
             out += "Intermediate node with ";
-            out += std::to_string(node->getDataFrame().length());
+            out += std::to_string(node->getWeight());
             out += " observation(s); split on column ";
             out += std::to_string(node->getSplitFeature());
             out += " with threshold ";
@@ -195,17 +277,16 @@ std::string DecisionTree::to_string() const
             out += " .";
         } else {
             out += "LEAF NODE WITH ";
-            out += std::to_string(node->getDataFrame().length());
+            out += std::to_string(node->getWeight());
             out += " OBSERVATION(S); ";
             if (this->isRegressionTree()){
                 // Regression tree:
                 out += "mean value: ";
-                out += std::to_string(node->getDataFrame().col(-1).mean());
             } else {
                 // Classification tree:
                 out += "majority class: ";
-                out += std::to_string(LabelCounter(node->getDataFrame().col(-1)).get_most_frequent());
             }
+            out += std::to_string(node->getPrediction());
             out += " .";
         }
         out += "\n";
@@ -232,38 +313,101 @@ std::ostream& operator<<(std::ostream& os, const DecisionTree& tree)
 
 // Utilities:
 
-double DecisionTree::calculateLoss(DataFrame* dataframe) const
+int DecisionTree::countObservations(const std::vector<int>& rows) const
+{
+    /** Total sample weight of given rows (i.e. number of observations, counting repeats). */
+    int count = 0;
+    for (int row : rows)
+    {
+        count += this->sample_weights_[row];
+    }
+    return count;
+}
+
+LabelCounter DecisionTree::countLabels(const std::vector<int>& rows) const
+{
+    /** Count labels of given rows (each row counted as many times as its sample weight). */
+    LabelCounter label_counter = LabelCounter();
+    for (int row : rows)
+    {
+        label_counter.increment(this->labels_[row], this->sample_weights_[row]);
+    }
+    return label_counter;
+}
+
+double DecisionTree::calculateLoss(const std::vector<int>& rows) const
 {
     /** Calculate loss before split. */
-    assert (dataframe->length()>0);  // Vector should be non-empty.
+    assert (rows.size()>0);  // Vector should be non-empty.
+    DataVector labels = DataVector(false);  // is_row=false.
+    std::vector<int> weights;
+    for (int row : rows)
+    {
+        labels.addValue(this->labels_[row]);
+        weights.push_back(this->sample_weights_[row]);
+    }
     LossFunction loss_func = LossFunction(this->loss_);
-    double loss = loss_func.calculate(dataframe);
+    double loss = loss_func.calculate(labels, weights);
     return loss;
 }
 
-double DecisionTree::calculateSplitLoss(DataFrame* left_dataframe, DataFrame* right_dataframe) const
+double DecisionTree::calculateSplitLoss(const std::vector<int>& left_rows, const std::vector<int>& right_rows) const
 {
     /** Calculate loss on split dataset using weighted average of loss in each split. */
-    int left_size = left_dataframe->length();
-    int right_size = right_dataframe->length();
+    int left_size = this->countObservations(left_rows);
+    int right_size = this->countObservations(right_rows);
     int total_size = left_size + right_size;
     assert ( (left_size>0) and (right_size>0) );  // Both vectors should be non-empty.
     // Get loss for each vector:
-    LossFunction loss_func = LossFunction(this->loss_);
-    double left_loss = loss_func.calculate(left_dataframe->col(-1));  // Get class labels from last column.
-    double right_loss = loss_func.calculate(right_dataframe->col(-1));  // Get class labels from last column.
+    double left_loss = this->calculateLoss(left_rows);
+    double right_loss = this->calculateLoss(right_rows);
     // Get weighted average of loss:
     double loss = (left_loss*left_size/total_size) + (right_loss*right_size/total_size);
     return loss;
 }
 
-std::pair<int,double> DecisionTree::findBestSplit(TreeNode *node)
+double DecisionTree::calculatePrediction(const std::vector<int>& rows) const
 {
-    /** Find best split at this node. */
-    DataFrame dataframe = node->getDataFrame();
-    // Must have enough data to split
-    assert (dataframe.length()>1);
-    std::pair<int,double> split;
+    /**
+     * Mean value (regression) or majority class (classification) of given rows, counting sample weights.
+     * Each label is added once per unit of weight, so the mean is exactly that of the rows repeated in place.
+     */
+    assert (rows.size()>0);
+    if (this->isRegressionTree()) {
+        double sum = 0;
+        for (int row : rows)
+        {
+            for (int k = 0; k < this->sample_weights_[row]; k++)
+            {
+                sum += this->labels_[row];
+            }
+        }
+        return sum / this->countObservations(rows);
+    } else {
+        return this->countLabels(rows).get_most_frequent();
+    }
+}
+
+std::vector<double> DecisionTree::calculateDistribution(const std::vector<int>& rows) const
+{
+    /** Proportion of each class (in order of sorted class labels) in given rows, counting sample weights. */
+    std::vector<double> distribution(this->classes_.size(), 0.0);
+    for (int row : rows)
+    {
+        int class_id = std::lower_bound(this->classes_.begin(), this->classes_.end(), this->labels_[row]) - this->classes_.begin();
+        distribution[class_id] += this->sample_weights_[row];
+    }
+    int total = this->countObservations(rows);
+    for (int c = 0; c < distribution.size(); c++)
+    {
+        distribution[c] /= total;
+    }
+    return distribution;
+}
+
+std::vector<int> DecisionTree::featureOrder()
+{
+    /** Order in which features are explored at a split (only the first mtry_ are used). */
     // Vector of indices which may or may not be shuffled.
     std::vector<int> shuf_inds(this->num_features_);
     // Create vector of column indices, equivalent to np.arange(0, df.shape[-1])
@@ -277,6 +421,28 @@ std::pair<int,double> DecisionTree::findBestSplit(TreeNode *node)
             std::swap(shuf_inds[i], shuf_inds[i+(std::rand() % (this->num_features_-i))]);
         }
     }
+    return shuf_inds;
+}
+
+std::pair<int,double> DecisionTree::findBestSplit(const std::vector<int>& rows, const std::vector<std::vector<int>>& sorted_rows)
+{
+    /** Find best split at this node (with the configured split search). */
+    if (this->split_method_=="presorted") {
+        return this->findPresortedSplit(rows, sorted_rows);
+    } else if (this->split_method_=="histogram") {
+        return this->findHistogramSplit(rows);
+    } else {
+        return this->findExactSplit(rows);
+    }
+}
+
+std::pair<int,double> DecisionTree::findExactSplit(const std::vector<int>& rows)
+{
+    /** Find best split by trying every unique value of each feature as a threshold. */
+    // Must have enough data to split
+    assert (rows.size()>1);
+    std::pair<int,double> split;
+    std::vector<int> shuf_inds = this->featureOrder();
     // Initialize temporary variables:
     bool first_pass = true;
     int best_column = -1; 
@@ -286,7 +452,8 @@ std::pair<int,double> DecisionTree::findBestSplit(TreeNode *node)
     // Explore possible splits:
     for (int i = 0; i < this->mtry_; i++){
         col = shuf_inds[i];
-        std::vector<double> col_vals = dataframe.col(col).vector();
+        std::vector<double> col_vals;
+        for (int row : rows){ col_vals.push_back(this->dataframe_.value(row, col)); }
         // Remove duplicates:
         std::sort(col_vals.begin(), col_vals.end());
         col_vals.erase(std::unique(col_vals.begin(), col_vals.end()), col_vals.end());
@@ -295,10 +462,18 @@ std::pair<int,double> DecisionTree::findBestSplit(TreeNode *node)
             // Don't split on last value (because it will produce empty `right`).
             double val = col_vals[j];
             // But splitting on first value works as <= means left won't be empty
-            // Split dataset using current column and threshold, score, and update if best:
+            // Split rows using current column and threshold (as in DataFrame::split), score, and update if best:
             // equal_goes_left=true.
-            std::vector<DataFrame> dataset_splits = dataframe.split(col, val, true);
-            loss = this->calculateSplitLoss(&dataset_splits[0],&dataset_splits[1]);
+            std::vector<int> left_rows;
+            std::vector<int> right_rows;
+            for (int row : rows){
+                if (this->dataframe_.value(row, col)>val) {
+                    right_rows.push_back(row);
+                } else {
+                    left_rows.push_back(row);
+                }
+            }
+            loss = this->calculateSplitLoss(left_rows, right_rows);
             if ((first_pass) or (loss<best_loss)){
                 first_pass = false;
                 best_column = col;
@@ -313,26 +488,272 @@ std::pair<int,double> DecisionTree::findBestSplit(TreeNode *node)
     return split;
 }
 
-void DecisionTree::fit_(TreeNode* node)
+std::pair<int,double> DecisionTree::findPresortedSplit(const std::vector<int>& rows, const std::vector<std::vector<int>>& sorted_rows)
+{
+    /**
+     * Find best split by scanning rows that are already sorted by each feature.
+     * Candidate thresholds, their order and the tie-breaking rule are the same as in the exact search,
+     * but the loss of every candidate is updated incrementally in a single pass over the sorted rows.
+     * Regression losses updated this way are rounded differently from those of the exact search, so candidates within
+     * rounding noise of the best one are scored again as in the exact search (on the node's rows), which picks among them.
+     */
+    int num_rows = sorted_rows[0].size();
+    int total_size = this->countObservations(sorted_rows[0]);
+    // Must have enough data to split
+    assert (num_rows>1);
+    std::vector<int> shuf_inds = this->featureOrder();
+    LossFunction loss_func = LossFunction(this->loss_);
+    // Initialize temporary variables:
+    bool first_pass = true;
+    int best_column = -1;
+    int col;
+    double best_threshold = -1.0;
+    double best_loss, loss;
+    std::vector<std::pair<double,std::pair<int,double>>> candidates;  // Loss, feature and threshold of each regression candidate.
+    // Explore possible splits:
+    for (int i = 0; i < this->mtry_; i++){
+        col = shuf_inds[i];
+        const std::vector<int>& col_rows = sorted_rows[col];
+        // Running statistics for the right side (regression: MSE of each suffix; classification: label counts):
+        std::vector<double> right_losses;
+        LabelCounter left_counter = LabelCounter();
+        LabelCounter right_counter = LabelCounter();
+        double mean = 0;
+        double m2 = 0;
+        int count = 0;
+        if (this->isRegressionTree()) {
+            right_losses = std::vector<double>(num_rows, 0.0);
+            for (int j = num_rows-1; j > 0; j--){
+                // Weighted Welford update (numerically stable running mean and sum of squared errors):
+                int weight = this->sample_weights_[col_rows[j]];
+                double label = this->labels_[col_rows[j]];
+                double delta = label-mean;
+                count += weight;
+                mean += weight*delta/count;
+                m2 += weight*delta*(label-mean);
+                right_losses[j] = m2/count;
+            }
+            mean = 0;
+            m2 = 0;
+        } else {
+            for (int j = 0; j < num_rows; j++){ right_counter.increment(this->labels_[col_rows[j]], this->sample_weights_[col_rows[j]]); }
+        }
+        // Move rows from right to left one at a time, scoring each split between distinct values:
+        int left_size = 0;
+        for (int j = 0; j < num_rows-1; j++){
+            int weight = this->sample_weights_[col_rows[j]];
+            double label = this->labels_[col_rows[j]];
+            left_size += weight;
+            int right_size = total_size-left_size;
+            double left_loss, right_loss;
+            if (this->isRegressionTree()) {
+                double delta = label-mean;
+                mean += weight*delta/left_size;
+                m2 += weight*delta*(label-mean);
+            } else {
+                left_counter.increment(label, weight);
+                right_counter.decrement(label, weight);
+            }
+            // Only split between distinct values (equal values always go left together):
+            unsigned int rank = this->ranked_->rank(col_rows[j], col);
+            if (rank==this->ranked_->rank(col_rows[j+1], col)) { continue; }
+            if (this->isRegressionTree()) {
+                left_loss = m2/left_size;
+                right_loss = right_losses[j+1];
+            } else {
+                left_loss = loss_func.calculate(left_counter);
+                right_loss = loss_func.calculate(right_counter);
+            }
+            // Get weighted average of loss (as in calculateSplitLoss):
+            loss = (left_loss*left_size/total_size) + (right_loss*right_size/total_size);
+            if (this->isRegressionTree()) {
+                candidates.push_back(std::make_pair(loss, std::make_pair(col, this->ranked_->value(col, rank))));
+            }
+            if ((first_pass) or (loss<best_loss)){
+                first_pass = false;
+                best_column = col;
+                best_threshold = this->ranked_->value(col, rank);
+                best_loss = loss;
+            }
+        }
+    }
+    if ( this->isRegressionTree() and (!first_pass) ) {
+        // Score near-ties with the arithmetic of the exact search (in the same order), and keep the first smallest loss:
+        double limit = best_loss + DECISION_TREE_LOSS_TOLERANCE*this->calculateLoss(rows);
+        first_pass = true;
+        for (const std::pair<double,std::pair<int,double>>& candidate : candidates)
+        {
+            if (candidate.first>limit) { continue; }
+            std::vector<int> left_rows;
+            std::vector<int> right_rows;
+            for (int row : rows){
+                if (this->dataframe_.value(row, candidate.second.first)>candidate.second.second) {
+                    right_rows.push_back(row);
+                } else {
+                    left_rows.push_back(row);
+                }
+            }
+            loss = this->calculateSplitLoss(left_rows, right_rows);
+            if ((first_pass) or (loss<best_loss)){
+                first_pass = false;
+                best_column = candidate.second.first;
+                best_threshold = candidate.second.second;
+                best_loss = loss;
+            }
+        }
+    }
+    return std::make_pair(best_column, best_threshold);
+}
+
+std::pair<int,double> DecisionTree::findHistogramSplit(const std::vector<int>& rows)
+{
+    /**
+     * Find best split by building a histogram of the node's rows over the bins of each feature,
+     * then scanning the bins from left to right. Candidate thresholds are bin boundaries (observed values).
+     */
+    int total_size = this->countObservations(rows);
+    // Must have enough data to split
+    assert (rows.size()>1);
+    std::vector<int> shuf_inds = this->featureOrder();
+    LossFunction loss_func = LossFunction(this->loss_);
+    int num_classes = this->classes_.size();
+    // Initialize temporary variables:
+    bool first_pass = true;
+    int best_column = -1;
+    int col;
+    double best_threshold = -1.0;
+    double best_loss, loss;
+    // Explore possible splits:
+    for (int i = 0; i < this->mtry_; i++){
+        col = shuf_inds[i];
+        int num_bins = this->binned_->num_bins(col);
+        // Build histogram (regression: count, sum and sum of squares; classification: count of each class), with sample weights:
+        std::vector<int> counts(num_bins, 0);
+        std::vector<double> sums(num_bins, 0.0);
+        std::vector<double> sq_sums(num_bins, 0.0);
+        std::vector<int> class_counts(num_bins*num_classes, 0);
+        for (int row : rows){
+            int b = this->binned_->bin(row, col);
+            int weight = this->sample_weights_[row];
+            counts[b] += weight;
+            if (this->isRegressionTree()) {
+                double label = this->labels_[row];
+                sums[b] += weight*label;
+                sq_sums[b] += weight*label*label;
+            } else {
+                class_counts[b*num_classes+this->class_ids_[row]] += weight;
+            }
+        }
+        // Totals over all bins:
+        double total_sum = 0;
+        double total_sq_sum = 0;
+        std::vector<int> total_class_counts(num_classes, 0);
+        for (int b = 0; b < num_bins; b++){
+            total_sum += sums[b];
+            total_sq_sum += sq_sums[b];
+            for (int k = 0; k < num_classes; k++){ total_class_counts[k] += class_counts[b*num_classes+k]; }
+        }
+        // Scan bins, moving each one from right to left (empty bins give the same split as the previous bin):
+        int left_size = 0;
+        double left_sum = 0;
+        double left_sq_sum = 0;
+        std::vector<int> left_class_counts(num_classes, 0);
+        for (int b = 0; b < num_bins-1; b++){
+            if (counts[b]==0) { continue; }
+            left_size += counts[b];
+            left_sum += sums[b];
+            left_sq_sum += sq_sums[b];
+            for (int k = 0; k < num_classes; k++){ left_class_counts[k] += class_counts[b*num_classes+k]; }
+            int right_size = total_size-left_size;
+            if (right_size==0) { break; }
+            double left_loss, right_loss;
+            if (this->isRegressionTree()) {
+                double left_mean = left_sum/left_size;
+                double right_mean = (total_sum-left_sum)/right_size;
+                left_loss = std::max(0.0, left_sq_sum/left_size - left_mean*left_mean);
+                right_loss = std::max(0.0, (total_sq_sum-left_sq_sum)/right_size - right_mean*right_mean);
+            } else {
+                LabelCounter left_counter = LabelCounter();
+                LabelCounter right_counter = LabelCounter();
+                for (int k = 0; k < num_classes; k++){
+                    left_counter.increment(this->classes_[k], left_class_counts[k]);
+                    right_counter.increment(this->classes_[k], total_class_counts[k]-left_class_counts[k]);
+                }
+                left_loss = loss_func.calculate(left_counter);
+                right_loss = loss_func.calculate(right_counter);
+            }
+            // Get weighted average of loss (as in calculateSplitLoss):
+            loss = (left_loss*left_size/total_size) + (right_loss*right_size/total_size);
+            if ((first_pass) or (loss<best_loss)){
+                first_pass = false;
+                best_column = col;
+                best_threshold = this->binned_->upper(col, b);
+                best_loss = loss;
+            }
+        }
+    }
+    return std::make_pair(best_column, best_threshold);
+}
+
+std::vector<std::vector<int>> DecisionTree::presort() const
+{
+    /**
+     * Sort the training rows with non-zero weight by each feature
+     * (counting sort on ranks; ties keep their original order).
+     */
+    std::vector<std::vector<int>> sorted_rows;
+    for (int i = 0; i < this->num_features_; i++)
+    {
+        std::vector<int> rows;
+        for (int row : this->ranked_->sorted_rows(i))
+        {
+            if (this->sample_weights_[row]>0) { rows.push_back(row); }
+        }
+        sorted_rows.push_back(rows);
+    }
+    return sorted_rows;
+}
+
+bool DecisionTree::stopFitting(TreeNode* node, const std::vector<int>& rows) const
 {
-    DataFrame dataframe = node->getDataFrame();
-    LabelCounter label_counter = LabelCounter(dataframe.col(-1));
+    /** Check stopping conditions to decide whether a node should remain a leaf. */
+    LabelCounter label_counter = this->countLabels(rows);
     double proportion = label_counter.get_values().max()/label_counter.size();
+    int num_observations = node->getWeight();
     if ( label_counter.size()==1 ) {
-        return;  // Prune if there is only one class left.
-    } else if ( dataframe.length()<2 ) {
-        return;  // Prune if there is not enough data to split.
+        return true;  // Prune if there is only one class left.
+    } else if ( num_observations<2 ) {
+        return true;  // Prune if there is not enough data to split.
     } else if ( (this->max_height_!=-1) and (node->getDepth()+1>=this->max_height_) ) {
-        return;  // Prune if adding children would exceed max depth:
+        return true;  // Prune if adding children would exceed max depth:
     } else if ( (this->max_leaves_!=-1) and (this->num_leaves_+1>=this->max_leaves_) ) {
-        return;  // Prune if adding children would exceed max leaves:
-    } else if ( (this->min_obs_!=-1) and (dataframe.length()<=this->min_obs_) ) {
-        return;  // Prune if node is below minimum leave size.
+        return true;  // Prune if adding children would exceed max leaves:
+    } else if ( (this->min_obs_!=-1) and (num_observations<=this->min_obs_) ) {
+        return true;  // Prune if node is below minimum leave size.
     } else if ( (this->max_prop_!=-1) and (  proportion>=this->max_prop_) ) {
-        return;  // Prune if proportion of majority label is above threshold.
+        return true;  // Prune if proportion of majority label is above threshold.
+    }
+    return false;
+}
+
+void DecisionTree::fit_(TreeNode* node, std::vector<int>& rows, std::vector<std::vector<int>>& sorted_rows)
+{
+    /**
+     * Helper function to perform fitting recursively.
+     *    rows        : Training rows at this node (in their original order).
+     *    sorted_rows : The same rows sorted by each feature (presorted split search only).
+     */
+    // Record number of observations and prediction at this node:
+    node->setWeight(this->countObservations(rows));
+    node->setPrediction(this->calculatePrediction(rows));
+    if (!this->isRegressionTree()) {
+        node->setDistribution(this->calculateDistribution(rows));
+    }
+    if (this->stopFitting(node, rows)) {
+        return;
     }
     // Find best split at this node:
-    std::pair<int,double> split = this->findBestSplit(node);
+    std::pair<int,double> split = this->findBestSplit(rows, sorted_rows);
     int split_feature = split.first;
     double split_threshold = split.second;
     // To handle scenario where all columns within mtry have just 1 unique value
@@ -342,13 +763,47 @@ void DecisionTree::fit_(TreeNode* node)
     }
     node->setSplitFeature(split_feature);
     node->setSplitThreshold(split_threshold);
-    // Calculate results of best split:
-    std::vector<DataFrame> dataset_splits = dataframe.split(split_feature,split_threshold,true);  // equal_goes_left=true.
-    DataFrame left_data = dataset_splits[0];
-    DataFrame right_data = dataset_splits[1];
+    // Calculate results of best split (same rule as DataFrame::split with equal_goes_left=true):
+    std::vector<int> left_rows;
+    std::vector<int> right_rows;
+    DataFrame left_data = DataFrame();
+    DataFrame right_data = DataFrame();
+    for (int row : rows)
+    {
+        if (this->dataframe_.value(row, split_feature)>split_threshold) {
+            right_rows.push_back(row);
+            right_data.addRow(this->dataframe_.row(row));
+        } else {
+            left_rows.push_back(row);
+            left_data.addRow(this->dataframe_.row(row));
+        }
+    }
     if ( (left_data.length()==0) or (right_data.length()==0) ) {
         return;  // Prune if best split does not actually split the dataset.
     }
+    // Stably partition each sorted list so that both children stay sorted:
+    std::vector<std::vector<int>> left_sorted_rows;
+    std::vector<std::vector<int>> right_sorted_rows;
+    if (sorted_rows.size()>0) {
+        unsigned int split_rank = this->ranked_->encode(split_feature, split_threshold);
+        left_sorted_rows = std::vector<std::vector<int>>(this->num_features_);
+        right_sorted_rows = std::vector<std::vector<int>>(this->num_features_);
+        for (int i = 0; i < this->num_features_; i++)
+        {
+            left_sorted_rows[i].reserve(left_rows.size());
+            right_sorted_rows[i].reserve(right_rows.size());
+            for (int row : sorted_rows[i])
+            {
+                if (this->ranked_->rank(row, split_feature)<=split_rank) {
+                    left_sorted_rows[i].push_back(row);
+                } else {
+                    right_sorted_rows[i].push_back(row);
+                }
+            }
+        }
+    }
+    rows = {};  // Release this node's lists before recursing.
+    sorted_rows = {};
     // If split produces two non-empty dataframes, recurse to (new) children:
     this->num_leaves_ += 1;  // Each split causes net addition of 1 leaf.
     TreeNode *left_child = new TreeNode(left_data);
@@ -356,20 +811,54 @@ void DecisionTree::fit_(TreeNode* node)
     node->setLeft(left_child);
     node->setRight(right_child);
     // Recurse to (new) children:
-    this->fit_(left_child);
-    this->fit_(right_child);
+    this->fit_(left_child, left_rows, left_sorted_rows);
+    this->fit_(right_child, right_rows, right_sorted_rows);
 }
 
 double DecisionTree::predict_(DataVector* observation) const
 {
     /** Helper function to perform prediction on a single observation. */
+    return this->predict_one(observation->data(), observation->size());
+}
+
+DataVector DecisionTree::predict(DataFrame* testdata) const
+{
+    /** Perform prediction sequentially on each observation and collect a vector of predictions. */
+    DataVector predictions = DataVector(false);  // is_row=false.
+    // Make sure tree has been fitted before prediction:
+    assert (this->isFitted());
+    // Make sure dataframe has the correct number of features (or one extra column with labels).
+    assert ( (testdata->width()==this->num_features_) or (testdata->width()==this->num_features_+1) );
+    for (int i = 0; i < testdata->length(); i++)
+    {
+        DataVector* observation = testdata->row(i);
+        double prediction = this->predict_(observation);
+        predictions.addValue(prediction);
+    }
+    return predictions;
+}
+
+double DecisionTree::predict(DataVector* observation) const
+{
+    /** Perform prediction on a single observation. */
+    assert (this->isFitted());
+    return this->predict_(observation);
+}
+
+double DecisionTree::predict_one(const double* features, size_t n) const
+{
+    /**
+     * Perform prediction on a single observation given as raw values (features[0],...,features[n-1]),
+     * without constructing a DataFrame or allocating anything.
+     */
+    assert (this->isFitted());
+    // Make sure observation has the correct number of features (or one extra value with its label).
+    assert ( (n==this->num_features_) or (n==this->num_features_+1) );
     TreeNode* node = this->root_;
     // Starting at root node, traverse tree while going left or right according to trained splitting criteria:
     while (!node->isLeaf())
     {
-        int split_feature = node->getSplitFeature();
-        double split_threshold = node->getSplitThreshold();
-        if ( observation->value(split_feature) <= split_threshold ){
+        if ( features[node->getSplitFeature()] <= node->getSplitThreshold() ){
             assert (node->hasLeft());  // A non-leaf node should have both left and right children.
             node = node->getLeft();
         } else {
@@ -377,30 +866,221 @@ double DecisionTree::predict_(DataVector* observation) const
             node = node->getRight();
         }
     }
-    // Make prediction based on whichever leaf is reached by the traversal:
-    double prediction;
-    if (this->isRegressionTree()) {
-        // Regression tree: Predict mean of training data at terminal node:
-        prediction = node->getDataFrame().col(-1).mean();
-    } else {
-        // Classification tree: Predict majority class of training data at terminal node:
-        prediction = LabelCounter(node->getDataFrame().col(-1)).get_most_frequent();
+    // Make prediction based on whichever leaf is reached by the traversal
+    // (mean value or majority class of training data at terminal node, computed while fitting):
+    return node->getPrediction();
+}
+
+void DecisionTree::predict_one(const double* features, size_t n, double* output) const
+{
+    /** Perform prediction on a single observation given as raw values, writing it to output[0]. */
+    output[0] = this->predict_one(features, n);
+}
+
+template <typename T>
+const TreeNode* DecisionTree::findLeaf(const T* features, size_t col_stride) const
+{
+    /** Find the leaf reached by a single observation whose values are col_stride elements apart (double or float). */
+    const TreeNode* node = this->root_;
+    while (!node->isLeaf())
+    {
+        if ( double(features[node->getSplitFeature()*col_stride]) <= node->getSplitThreshold() ){
+            node = node->getLeft();
+        } else {
+            node = node->getRight();
+        }
     }
-    return prediction;
+    return node;
 }
-DataVector DecisionTree::predict(DataFrame* testdata) const
+
+template const TreeNode* DecisionTree::findLeaf<double>(const double* features, size_t col_stride) const;
+template const TreeNode* DecisionTree::findLeaf<float>(const float* features, size_t col_stride) const;
+
+template <typename T>
+double DecisionTree::predictStrided(const T* features, size_t col_stride) const
 {
-    /** Perform prediction sequentially on each observation and collect a vector of predictions. */
-    DataVector predictions = DataVector(false);  // is_row=false.
-    // Make sure tree has been fitted before prediction:
+    /** Perform prediction on a single observation whose values are col_stride elements apart (double or float). */
+    return this->findLeaf(features, col_stride)->getPrediction();
+}
+
+template double DecisionTree::predictStrided<double>(const double* features, size_t col_stride) const;
+template double DecisionTree::predictStrided<float>(const float* features, size_t col_stride) const;
+
+void DecisionTree::predict(const double* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const
+{
+    /**
+     * Perform prediction on each row of an external buffer, without copying it:
+     * value of feature f in row r is data[r*row_stride+f*col_stride]
+     * (row-major: row_stride=num_features and col_stride=1; column-major: row_stride=1 and col_stride=num_rows).
+     * Predictions are written to output[0],...,output[num_rows-1].
+     */
     assert (this->isFitted());
-    // Make sure dataframe has the correct number of features (or one extra column with labels).
+    // Make sure buffer has the correct number of features (or one extra column with labels).
+    assert ( (num_features==this->num_features_) or (num_features==this->num_features_+1) );
+    for (size_t r = 0; r < num_rows; r++)
+    {
+        output[r] = this->predictStrided(data+r*row_stride, col_stride);
+    }
+}
+
+void DecisionTree::predict(const float* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const
+{
+    /** Perform prediction on each row of an external buffer of floats (see above), without copying it. */
+    assert (this->isFitted());
+    assert ( (num_features==this->num_features_) or (num_features==this->num_features_+1) );
+    for (size_t r = 0; r < num_rows; r++)
+    {
+        output[r] = this->predictStrided(data+r*row_stride, col_stride);
+    }
+}
+
+void DecisionTree::predict_proba(const double* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const
+{
+    /**
+     * Probability of each class for each row of an external buffer (see predict), from the class distribution of
+     * the leaf it reaches. Row r of the output has the probabilities of getClasses() at output[r*num_classes+c].
+     */
+    assert (this->isFitted());
+    assert (!this->isRegressionTree());  // Probabilities are only defined for classification.
+    assert ( (num_features==this->num_features_) or (num_features==this->num_features_+1) );
+    size_t num_classes = this->classes_.size();
+    for (size_t r = 0; r < num_rows; r++)
+    {
+        const std::vector<double>& distribution = this->findLeaf(data+r*row_stride, col_stride)->getDistribution();
+        std::copy(distribution.begin(), distribution.end(), output+r*num_classes);
+    }
+}
+
+DataFrame DecisionTree::predict_proba(DataFrame* testdata) const
+{
+    /** Probability of each class for each observation (one row per observation, one column per class in getClasses()). */
+    assert (this->isFitted());
+    assert (!this->isRegressionTree());  // Probabilities are only defined for classification.
     assert ( (testdata->width()==this->num_features_) or (testdata->width()==this->num_features_+1) );
+    std::vector<std::vector<double>> probabilities;
     for (int i = 0; i < testdata->length(); i++)
     {
-        DataVector* observation = testdata->row(i);
-        double prediction = this->predict_(observation);
-        predictions.addValue(prediction);
+        probabilities.push_back(this->findLeaf(testdata->row(i)->data())->getDistribution());
     }
-    return predictions;
+    return DataFrame(probabilities);
+}
+
+DecisionTree DecisionTree::clone() const
+{
+    /**
+     * Copy of the tree with a copy of each of its nodes, which can be changed (e.g. by mergeLeaves) without
+     * affecting this tree. Subtrees shared within the tree are copied once per use.
+     */
+    assert (this->fitted_);
+    DecisionTree tree = *this;
+    tree.root_ = this->cloneNodes_(this->root_);
+    tree.updateNodes_();
+    return tree;
+}
+
+TreeNode* DecisionTree::cloneNodes_(const TreeNode* node) const
+{
+    /** Copy the subtree rooted at given node (children first), and return the copy of its root. */
+    TreeNode* copy = new TreeNode(*node);
+    if (!node->isLeaf()) {
+        copy->setChildren(this->cloneNodes_(node->getLeft()), this->cloneNodes_(node->getRight()));
+    }
+    return copy;
+}
+
+int DecisionTree::mergeLeaves(const SubtreePool* pool)
+{
+    /**
+     * Turn every split whose children are leaves with the same prediction into a leaf (repeatedly, from the leaves up),
+     * and return the number of removed nodes. Predictions do not change; the class distribution of a merged leaf
+     * becomes that of its training rows (i.e. the weighted mean of the distributions of the two leaves).
+     * Removed leaves are deleted, except those kept in the given pool (if subtrees were shared with it),
+     * since other trees may still use them. Copies of the tree made before share its nodes, and must not be used afterwards.
+     */
+    assert (this->fitted_);
+    int removed = this->mergeLeaves_(this->root_, pool);
+    this->updateNodes_();
+    return removed;
+}
+
+int DecisionTree::mergeLeaves_(TreeNode* node, const SubtreePool* pool)
+{
+    /** Merge sibling leaves in the subtree rooted at given node (children first), and return the number of removed nodes. */
+    if (node->isLeaf()) {
+        return 0;
+    }
+    int removed = this->mergeLeaves_(node->getLeft(), pool) + this->mergeLeaves_(node->getRight(), pool);
+    TreeNode* left = node->getLeft();
+    TreeNode* right = node->getRight();
+    if ( left->isLeaf() and right->isLeaf() and (left->getPrediction()==right->getPrediction()) ) {
+        node->setPrediction(left->getPrediction());  // Same value (a mean over the rows of both leaves may differ by rounding).
+        node->setChildren(nullptr, nullptr);
+        removed += 2;
+        // Leaves kept in the pool may be used by other trees (and a shared leaf may be both children):
+        bool left_kept = (pool!=nullptr) and (pool->ids.count(left)>0);
+        bool right_kept = (pool!=nullptr) and (pool->ids.count(right)>0);
+        if (!left_kept) { delete left; }
+        if ( (!right_kept) and (right!=left) ) { delete right; }
+    }
+    return removed;
+}
+
+int DecisionTree::shareSubtrees(SubtreePool& pool)
+{
+    /**
+     * Replace every subtree by an identical one kept in the pool (from this tree or another one that used the same pool),
+     * adding those not found, and return the number of nodes replaced by kept ones.
+     * Predictions and class distributions do not change. Shared nodes keep the weight of the first copy
+     * (used to lay out compiled trees) and the depth in the last tree using them (used to print trees).
+     * Replaced nodes are deleted (unless kept in the pool), as in mergeLeaves.
+     */
+    assert (this->fitted_);
+    int shared = 0;
+    this->root_ = this->shareSubtrees_(this->root_, pool, shared);
+    this->updateNodes_();
+    return shared;
+}
+
+TreeNode* DecisionTree::shareSubtrees_(TreeNode* node, SubtreePool& pool, int& shared)
+{
+    /** Share subtrees below given node (children first), and return the kept copy of this subtree. */
+    std::vector<double> key;
+    TreeNode* left = nullptr;
+    TreeNode* right = nullptr;
+    if (node->isLeaf()) {
+        const std::vector<double>& distribution = node->getDistribution();
+        key = {-1, node->getPrediction()};  // Features are non-negative, so leaf keys differ from split keys.
+        key.insert(key.end(), distribution.begin(), distribution.end());
+    } else {
+        left = this->shareSubtrees_(node->getLeft(), pool, shared);
+        right = this->shareSubtrees_(node->getRight(), pool, shared);
+        key = {double(node->getSplitFeature()), node->getSplitThreshold(), double(pool.ids.at(left)), double(pool.ids.at(right))};
+    }
+    auto found = pool.nodes.find(key);
+    TreeNode* kept = (found==pool.nodes.end()) ? node : found->second;
+    if ( (kept!=node) and (pool.ids.count(node)==0) ) {
+        // Duplicate: its children were already replaced by kept ones (and deleted), so it is deleted without relinking them:
+        delete node;
+    } else if ( (left!=nullptr) and ( (left!=node->getLeft()) or (right!=node->getRight()) ) ) {
+        node->setChildren(left, right);
+    }
+    if (found==pool.nodes.end()) {
+        int id = pool.ids.size();
+        pool.ids.emplace(node, id);  // A kept node merged into a leaf since it was added keeps its id.
+        pool.nodes[key] = node;
+    }
+    if (kept!=node) {
+        shared++;
+    }
+    return kept;
+}
+
+void DecisionTree::updateNodes_()
+{
+    /** Update sizes, heights and depths of nodes, and the list of leaves, after changing the structure of the tree. */
+    this->root_->updateSizes();
+    this->root_->updateHeights();
+    this->root_->updateDepths();
+    this->leaves_ = this->root_->findLeaves();
+    this->num_leaves_ = this->leaves_.size();
 }
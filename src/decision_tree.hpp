@@ -5,6 +5,19 @@
 #include "datasets.hpp"
 #include "losses.hpp"
 #include <utility>  // std::pair, std::make_pair
+#include <memory>  // std::shared_ptr.
+#include <map>  // std::map.
+#include <unordered_map>  // std::unordered_map.
+
+struct SubtreePool
+{
+    /**
+     * Subtrees kept once and shared between trees (see DecisionTree::shareSubtrees), keyed by content:
+     * a leaf by its prediction and class distribution, a split by its feature, threshold and the ids of its children.
+     * */
+    std::map<std::vector<double>,TreeNode*> nodes;  // Node kept for each key.
+    std::unordered_map<const TreeNode*,int> ids;  // Id of each kept node (order of insertion).
+};
 
 class DecisionTree
 {
@@ -26,13 +39,34 @@ private:
     bool fitted_;  // State variable: Flag indicated whether or not the tree has been trained.
     int meta_seed_;  // Metaseed for random seed generator.
     SeedGenerator seed_gen;  // Random seed generator.
+    std::string split_method_;  // String indicating split search method ("exact", "presorted" or "histogram").
+    std::vector<int> sample_weights_;  // Number of times each training row is counted (e.g. bootstrap multiplicity).
+    std::shared_ptr<const RankedDataFrame> ranked_;  // Rank-encoded features, possibly shared between trees (used by presorted split search).
+    std::shared_ptr<const BinnedDataFrame> binned_;  // Binned features, possibly shared between trees (used by histogram split search).
+    std::vector<double> classes_;  // Sorted class labels (classification only).
+    std::vector<int> class_ids_;  // Position of each training label in classes_.
+    std::vector<double> labels_;  // Copy of labels (used while fitting).
 
     // Utilities:
-    void fit_(TreeNode* node);  // Helper function to perform fitting recursively.
+    bool stopFitting(TreeNode* node, const std::vector<int>& rows) const;  // Check stopping conditions at this node.
+    void fit_(TreeNode* node, std::vector<int>& rows, std::vector<std::vector<int>>& sorted_rows);  // Helper function to perform fitting recursively.
     double predict_(DataVector* observation) const;  // Helper function to perform prediction on a single observation.
-    std::pair<int,double> findBestSplit(TreeNode *node);  // Find best split at this node.
-    double calculateLoss(DataFrame* dataframe) const;  // Calculate loss before split.
-    double calculateSplitLoss(DataFrame* left_dataframe, DataFrame* right_dataframe) const;  // Calculate loss on split dataset.
+    std::vector<int> featureOrder();  // Order in which features are explored at a split (first mtry_ are used).
+    std::pair<int,double> findBestSplit(const std::vector<int>& rows, const std::vector<std::vector<int>>& sorted_rows);  // Find best split at this node.
+    std::pair<int,double> findExactSplit(const std::vector<int>& rows);  // Find best split by trying every unique value.
+    std::pair<int,double> findPresortedSplit(const std::vector<int>& rows, const std::vector<std::vector<int>>& sorted_rows);  // Find best split by scanning presorted rows.
+    std::pair<int,double> findHistogramSplit(const std::vector<int>& rows);  // Find best split by scanning bin histograms.
+    std::vector<std::vector<int>> presort() const;  // Sort (weighted) training rows by each feature (on ranks).
+    int countObservations(const std::vector<int>& rows) const;  // Total sample weight of given rows.
+    LabelCounter countLabels(const std::vector<int>& rows) const;  // Count labels of given rows (with sample weights).
+    double calculateLoss(const std::vector<int>& rows) const;  // Calculate loss before split.
+    double calculateSplitLoss(const std::vector<int>& left_rows, const std::vector<int>& right_rows) const;  // Calculate loss on split dataset.
+    double calculatePrediction(const std::vector<int>& rows) const;  // Mean value or majority class of given rows.
+    std::vector<double> calculateDistribution(const std::vector<int>& rows) const;  // Proportion of each class in given rows.
+    TreeNode* cloneNodes_(const TreeNode* node) const;  // Helper function to copy nodes recursively (returns the copy).
+    int mergeLeaves_(TreeNode* node, const SubtreePool* pool);  // Helper function to merge sibling leaves recursively (returns number of removed nodes).
+    TreeNode* shareSubtrees_(TreeNode* node, SubtreePool& pool, int& shared);  // Helper function to share subtrees recursively (returns kept node).
+    void updateNodes_();  // Update sizes, heights and depths of nodes, and list of leaves, after changing the structure.
 
 public:
 
@@ -40,7 +74,10 @@ public:
     DecisionTree(
         DataFrame dataframe, bool regression=false, std::string loss="gini_impurity",
         int mtry=-1, int max_height=-1, int max_leaves=-1, int min_obs=-1,
-        double max_prop=-1, int seed=-1
+        double max_prop=-1, int seed=-1, std::string split_method="exact",
+        std::vector<int> sample_weights={},
+        std::shared_ptr<const RankedDataFrame> ranked=nullptr,
+        std::shared_ptr<const BinnedDataFrame> binned=nullptr
     );
 
     // Getters:
@@ -51,6 +88,8 @@ public:
     TreeNode * getRoot() const;  // Root node in tree.
     std::vector<TreeNode*> getLeaves();  // Get leaves.
     DataFrame getDataFrame() const;  // Training data.
+    std::vector<int> getSampleWeights() const;  // Number of times each training row was counted.
+    std::vector<double> getClasses() const;  // Sorted class labels of training data (classification only).
     std::string to_string() const;  // Return the DecisionTree as a string.
     void print() const;  // Print the DecisionTree.
 
@@ -61,6 +100,18 @@ public:
 
     // Utilities:
     DataVector predict(DataFrame* testdata) const;  // Perform prediction sequentially on each observation.
+    double predict(DataVector* observation) const;  // Perform prediction on a single observation.
+    double predict_one(const double* features, size_t n) const;  // Perform prediction on a single observation given as raw values (no allocation).
+    void predict_one(const double* features, size_t n, double* output) const;  // Same, writing the prediction to a caller-provided buffer.
+    template <typename T> const TreeNode* findLeaf(const T* features, size_t col_stride=1) const;  // Leaf reached by one observation with values col_stride apart.
+    template <typename T> double predictStrided(const T* features, size_t col_stride) const;  // Prediction for one observation with values col_stride apart.
+    void predict(const double* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const;  // Predict rows of an external (strided) buffer.
+    void predict(const float* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const;  // Predict rows of an external (strided) buffer.
+    DataFrame predict_proba(DataFrame* testdata) const;  // Probability of each class for each observation (one column per class).
+    void predict_proba(const double* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const;  // Same, for an external buffer (output: rows x classes).
+    DecisionTree clone() const;  // Copy of the tree with nodes of its own (a plain copy shares the nodes of the tree).
+    int mergeLeaves(const SubtreePool* pool=nullptr);  // Turn splits whose children are leaves with the same prediction into leaves (returns number of removed nodes).
+    int shareSubtrees(SubtreePool& pool);  // Replace subtrees by identical ones kept in a pool (returns number of replaced nodes).
 
 };
 
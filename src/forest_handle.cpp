@@ -0,0 +1,117 @@
+#include "forest_handle.hpp"
+#include "compiled_forest.hpp"
+#include "datasets.hpp"
+#include <assert.h>
+
+// Source of generation numbers (shared by all handles, so a number never identifies two forests):
+static std::atomic<uint64_t> forest_handle_generations(0);
+
+// Number of handles for which each thread keeps a reference to the forest it used last:
+#define FOREST_HANDLE_PINS 8
+
+struct ForestHandlePin
+{
+    /**
+     * Reference kept by a thread to the forest it used last with a handle
+     * (generations are never reused, so a new handle at the address of a destroyed one reloads its forest).
+     * */
+    const ForestHandle* handle = nullptr;  // Handle predicted through (or nullptr for an unused pin).
+    uint64_t generation = 0;  // Generation of the forest kept.
+    std::shared_ptr<const CompiledForest> forest;  // Forest kept alive for the thread.
+};
+
+// Pins of the calling thread (reused in round-robin order once all are taken):
+static thread_local ForestHandlePin forest_handle_pins[FOREST_HANDLE_PINS];
+static thread_local int forest_handle_next_pin = 0;
+
+// Constructors:
+ForestHandle::ForestHandle(std::shared_ptr<const CompiledForest> forest)
+{
+    /** Handle to a forest (which must not be modified while shared). */
+    assert (forest!=nullptr);
+    this->forest_ = forest;
+    this->generation_ = ++forest_handle_generations;
+}
+
+// Getters:
+std::shared_ptr<const CompiledForest> ForestHandle::load() const
+{
+    /** Current forest (the caller's reference stays valid, and the forest unchanged, after a swap). */
+    return std::atomic_load(&this->forest_);
+}
+
+uint64_t ForestHandle::getGeneration() const
+{
+    /** Number identifying the current forest (changes with every swap). */
+    return this->generation_.load(std::memory_order_acquire);
+}
+
+// Utilities:
+std::shared_ptr<const CompiledForest> ForestHandle::swap(std::shared_ptr<const CompiledForest> forest)
+{
+    /**
+     * Publish a new forest for all later predictions, and return the previous one
+     * (freed once the last prediction using it finishes and the caller drops it).
+     */
+    assert (forest!=nullptr);
+    std::shared_ptr<const CompiledForest> previous = std::atomic_exchange(&this->forest_, forest);
+    // Forest is published before its generation, so a thread seeing the new generation loads the new forest:
+    this->generation_.store(++forest_handle_generations, std::memory_order_release);
+    return previous;
+}
+
+const CompiledForest& ForestHandle::pin_() const
+{
+    /**
+     * Current forest, from the reference kept by this thread for this handle unless a swap happened since it was taken
+     * (so the common case is one atomic read, even when a thread alternates between a few handles).
+     * It stays alive until the next call from this thread through this handle (see releasePinned).
+     */
+    uint64_t current = this->generation_.load(std::memory_order_acquire);
+    ForestHandlePin* pin = nullptr;
+    for (int p = 0; p < FOREST_HANDLE_PINS; p++)
+    {
+        if (forest_handle_pins[p].handle==this) {
+            pin = &forest_handle_pins[p];
+            break;
+        }
+    }
+    if (pin==nullptr) {
+        pin = &forest_handle_pins[forest_handle_next_pin];
+        forest_handle_next_pin = (forest_handle_next_pin+1) % FOREST_HANDLE_PINS;
+        pin->handle = this;
+        pin->generation = 0;
+    }
+    if (current!=pin->generation) {
+        pin->forest = std::atomic_load(&this->forest_);
+        pin->generation = current;
+    }
+    return *pin->forest;
+}
+
+double ForestHandle::predict(const double* observation) const
+{
+    /** Prediction of the current forest for a single observation. */
+    return this->pin_().predict(observation);
+}
+
+void ForestHandle::predict(const double* data, size_t num_rows, size_t num_features, size_t row_stride, double* output) const
+{
+    /** Predict each row of an external row-major buffer with the current forest (see CompiledForest::predict). */
+    this->pin_().predict(data, num_rows, num_features, row_stride, output);
+}
+
+DataVector ForestHandle::predict(DataFrame* testdata) const
+{
+    /** Perform prediction on each observation with the current forest. */
+    return this->pin_().predict(testdata);
+}
+
+void ForestHandle::releasePinned()
+{
+    /** Drop the references to forests kept by the calling thread (e.g. before it goes idle), so swapped-out forests can be freed. */
+    for (int p = 0; p < FOREST_HANDLE_PINS; p++)
+    {
+        forest_handle_pins[p] = ForestHandlePin();
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef FOREST_HANDLE_HPP
+#define FOREST_HANDLE_HPP
+
+#include "compiled_forest.hpp"
+#include "datasets.hpp"
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+class ForestHandle
+{
+    /**
+     * Shared, replaceable reference to an immutable CompiledForest, for scoring threads while a model is retrained.
+     * swap publishes a new forest atomically: predictions already running finish with the forest they started with
+     * (kept alive by reference counting), and later ones use the new forest.
+     * Predicting through the handle does not lock: each thread keeps a reference to the forest it used last with each of
+     * the last few handles it predicted through, and only loads the shared one again when the generation number (one
+     * atomic read per call) has changed.
+     * Consequently, a forest replaced by swap is only released by a thread at its next prediction through that handle
+     * (or when the thread's reference is reused for another handle, or the thread calls releasePinned or exits):
+     * threads going idle after a swap should call releasePinned so they do not keep the old forest alive.
+     * */
+
+private:
+
+    // Attributes:
+    std::shared_ptr<const CompiledForest> forest_;  // Current forest (only accessed with atomic_load/atomic_exchange).
+    std::atomic<uint64_t> generation_;  // Number identifying the current forest (unique across all handles).
+
+    // Utilities:
+    const CompiledForest& pin_() const;  // Current forest, kept alive for this thread until its next call through this handle.
+
+public:
+
+    // Constructors:
+    ForestHandle(std::shared_ptr<const CompiledForest> forest);
+    ForestHandle(const ForestHandle&) = delete;
+    ForestHandle& operator=(const ForestHandle&) = delete;
+
+    // Getters:
+    std::shared_ptr<const CompiledForest> load() const;  // Current forest (stays valid after a swap).
+    uint64_t getGeneration() const;  // Number identifying the current forest (changes with every swap).
+
+    // Utilities:
+    std::shared_ptr<const CompiledForest> swap(std::shared_ptr<const CompiledForest> forest);  // Publish a new forest (returns the previous one).
+    double predict(const double* observation) const;  // Prediction of the current forest for a single observation.
+    void predict(const double* data, size_t num_rows, size_t num_features, size_t row_stride, double* output) const;  // Predict rows of an external row-major buffer.
+    DataVector predict(DataFrame* testdata) const;  // Perform prediction on each observation.
+    static void releasePinned();  // Drop the references to forests kept by the calling thread.
+
+};
+
+#endif
@@ -0,0 +1,274 @@
+#include "lazy_forest.hpp"
+#include "compiled_forest.hpp"
+#include "datasets.hpp"
+#include <assert.h>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// First bytes of a file written by CompiledForest::saveIndexed:
+static const char LAZY_FOREST_MAGIC[8] = {'C','F','O','R','E','S','T','2'};
+
+// Constructors:
+LazyForest::LazyForest(std::string filename, bool prefetch)
+    : num_loaded_(0), stopping_(false)
+{
+    /**
+     * Open a forest written by CompiledForest::saveIndexed (only its header and index are read).
+     *    filename : Name of the file (it must not change while the forest is open).
+     *    prefetch : Start loading every tree in a background thread right away.
+     */
+    this->filename_ = filename;
+    int descriptor = open(filename.c_str(), O_RDONLY);
+    if (descriptor<0) {
+        throw std::runtime_error( "Could not open file for reading: "+filename );
+    }
+    struct stat status;
+    if (fstat(descriptor, &status)!=0) {
+        close(descriptor);
+        throw std::runtime_error( "Could not read file: "+filename );
+    }
+    this->size_ = status.st_size;
+    void* data = (this->size_>0) ? mmap(nullptr, this->size_, PROT_READ, MAP_PRIVATE, descriptor, 0) : MAP_FAILED;
+    close(descriptor);  // Mapping stays valid.
+    if (data==MAP_FAILED) {
+        throw std::runtime_error( "Could not map file: "+filename );
+    }
+    this->data_ = static_cast<const char*>(data);
+    // Header and index (the rest of the file is only read when trees are used):
+    bool valid = (this->size_>=sizeof(LAZY_FOREST_MAGIC)+4*sizeof(int64_t))
+        and (std::memcmp(this->data_, LAZY_FOREST_MAGIC, sizeof(LAZY_FOREST_MAGIC))==0);
+    if (valid) {
+        const int64_t* header = reinterpret_cast<const int64_t*>(this->data_+sizeof(LAZY_FOREST_MAGIC));
+        int64_t num_trees = header[2];
+        int64_t num_classes = header[3];
+        this->regression_ = header[0];
+        this->num_features_ = header[1];
+        size_t header_size = sizeof(LAZY_FOREST_MAGIC) + 4*sizeof(int64_t);
+        valid = (num_trees>0) and (num_classes>=0) and (this->num_features_>=0) and (this->regression_ or (num_classes>0))
+            and (header_size+(num_classes+2*num_trees)*sizeof(int64_t) <= this->size_);
+        if (valid) {
+            const double* classes = reinterpret_cast<const double*>(header+4);
+            const int64_t* index = header+4+num_classes;
+            this->classes_.assign(classes, classes+num_classes);
+            for (int t = 0; t < num_trees; t++)
+            {
+                int64_t offset = index[2*t];
+                int64_t size = index[2*t+1];
+                valid = valid and (offset>0) and (offset%alignof(CompiledNode)==0) and (size>0)
+                    and (offset+size*sizeof(CompiledNode) <= this->size_);
+                this->offsets_.push_back(offset);
+                this->sizes_.push_back(size);
+            }
+        }
+    }
+    if (!valid) {
+        munmap(const_cast<char*>(this->data_), this->size_);
+        throw std::runtime_error( "Not an indexed CompiledForest file (or corrupted): "+filename );
+    }
+    this->loaded_.reset(new std::once_flag[this->offsets_.size()]);
+    if (prefetch) {
+        this->prefetch();
+    }
+}
+
+LazyForest::~LazyForest()
+{
+    /** Stop prefetching (if running) and unmap the file. */
+    this->stopping_ = true;
+    if (this->prefetcher_.joinable()) {
+        this->prefetcher_.join();
+    }
+    munmap(const_cast<char*>(this->data_), this->size_);
+}
+
+// Getters:
+int LazyForest::getNumTrees() const
+{
+    /** Number of trees. */
+    return this->offsets_.size();
+}
+
+int LazyForest::getNumFeatures() const
+{
+    /** Number of features in dataset. */
+    return this->num_features_;
+}
+
+bool LazyForest::isRegressionTree() const
+{
+    /** Type of forest (classification or regression). */
+    return this->regression_;
+}
+
+std::vector<double> LazyForest::getClasses() const
+{
+    /** Sorted class labels (classification only). */
+    return this->classes_;
+}
+
+int LazyForest::getNumLoadedTrees() const
+{
+    /** Number of trees used (or prefetched) so far. */
+    return this->num_loaded_.load();
+}
+
+// Utilities:
+void LazyForest::load_(int tree) const
+{
+    /**
+     * Check that every position of a tree stays inside it (so prediction cannot read outside of the file),
+     * and that children of a split come after it (so prediction cannot loop forever), which also reads its pages from disk.
+     */
+    const CompiledNode* nodes = reinterpret_cast<const CompiledNode*>(this->data_+this->offsets_[tree]);
+    int64_t num_nodes = this->sizes_[tree];
+    bool valid = true;
+    for (int64_t position = 0; position < num_nodes; position++)
+    {
+        const CompiledNode& node = nodes[position];
+        valid = valid and (node.left<num_nodes) and (node.right<num_nodes);
+        valid = valid and ( ( (node.left==position) and (node.right==position) ) or ( (node.left>position) and (node.right>position) ) );
+        valid = valid and (node.feature>=0) and (node.feature<std::max(this->num_features_, 1));
+        valid = valid and (this->regression_ or ( (node.vote>=0) and (node.vote<this->classes_.size()) ));
+    }
+    if (!valid) {
+        throw std::runtime_error( "Corrupted tree "+std::to_string(tree)+" in file: "+this->filename_ );
+    }
+    this->num_loaded_++;
+}
+
+const CompiledNode* LazyForest::tree_(int tree) const
+{
+    /** Nodes of a tree (checked the first time, by one thread while the others wait; afterwards one atomic read). */
+    assert ( (tree>=0) and (tree<this->offsets_.size()) );
+    std::call_once(this->loaded_[tree], &LazyForest::load_, this, tree);
+    return reinterpret_cast<const CompiledNode*>(this->data_+this->offsets_[tree]);
+}
+
+void LazyForest::prefetch(bool background)
+{
+    /**
+     * Load every tree not used yet, in tree order: in a background thread (predictions go on meanwhile, and
+     * wait only for the tree being loaded), or in the calling thread with background=false.
+     * A corrupted tree stops the background thread (the error is thrown when the tree is used).
+     */
+    if (!background) {
+        for (int t = 0; t < this->offsets_.size(); t++)
+        {
+            this->tree_(t);
+        }
+        return;
+    }
+    if (this->prefetcher_.joinable()) {
+        return;  // Already started.
+    }
+    this->prefetcher_ = std::thread([this]() {
+        try {
+            for (int t = 0; (t < this->offsets_.size()) and (!this->stopping_); t++)
+            {
+                this->tree_(t);
+            }
+        } catch (const std::runtime_error&) {
+            return;
+        }
+    });
+}
+
+double LazyForest::predictTree(int tree, const double* observation) const
+{
+    /** Prediction of one tree for a single observation (loads only that tree). */
+    const CompiledNode* nodes = this->tree_(tree);
+    int position = 0;
+    while (nodes[position].left!=position)
+    {
+        const CompiledNode& node = nodes[position];
+        position = ( observation[node.feature] <= node.threshold ) ? node.left : node.right;
+    }
+    return nodes[position].value;
+}
+
+void LazyForest::predictRows_(const double* const* observations, int n, double* output) const
+{
+    /** Walk each tree with all observations (so each tree is looked up once), then aggregate in tree order. */
+    int width = this->regression_ ? 1 : this->classes_.size();
+    std::vector<double> sums(n*width, 0.0);
+    for (int t = 0; t < this->offsets_.size(); t++)
+    {
+        const CompiledNode* nodes = this->tree_(t);
+        for (int i = 0; i < n; i++)
+        {
+            const double* observation = observations[i];
+            int position = 0;
+            while (nodes[position].left!=position)
+            {
+                const CompiledNode& node = nodes[position];
+                position = ( observation[node.feature] <= node.threshold ) ? node.left : node.right;
+            }
+            if (this->regression_) {
+                sums[i] += nodes[position].value;
+            } else {
+                sums[i*width+nodes[position].vote] += 1;
+            }
+        }
+    }
+    for (int i = 0; i < n; i++)
+    {
+        output[i] = this->aggregate_(sums.data()+i*width);
+    }
+}
+
+double LazyForest::aggregate_(const double* sums) const
+{
+    /** Mean value (regression) or majority vote (classification, breaking ties in favor of smallest label). */
+    if (this->regression_) {
+        return sums[0] / this->offsets_.size();
+    }
+    int best = 0;
+    for (int c = 1; c < this->classes_.size(); c++)
+    {
+        if (sums[c]>sums[best]) { best = c; }
+    }
+    return this->classes_[best];
+}
+
+double LazyForest::predict(const double* observation) const
+{
+    /** Prediction of the forest for a single observation (same as the saved CompiledForest). */
+    double prediction;
+    this->predictRows_(&observation, 1, &prediction);
+    return prediction;
+}
+
+DataVector LazyForest::predict(DataFrame* testdata) const
+{
+    /** Perform prediction on each observation and collect a vector of predictions. */
+    assert ( (testdata->width()==this->num_features_) or (testdata->width()==this->num_features_+1) );
+    int num_rows = testdata->length();
+    std::vector<const double*> observations(num_rows);
+    for (int j = 0; j < num_rows; j++)
+    {
+        observations[j] = testdata->row(j)->data();
+    }
+    std::vector<double> predictions(num_rows);
+    this->predictRows_(observations.data(), num_rows, predictions.data());
+    return DataVector(predictions, false);  // is_row=false.
+}
+
+void LazyForest::predict(const double* data, size_t num_rows, size_t num_features, size_t row_stride, double* output) const
+{
+    /**
+     * Perform prediction on each row of an external row-major buffer (see CompiledForest::predict):
+     * feature f of row r is data[r*row_stride+f], and predictions are written to output[0],...,output[num_rows-1].
+     */
+    assert ( (num_features==this->num_features_) or (num_features==this->num_features_+1) );
+    assert (row_stride>=num_features);
+    std::vector<const double*> observations(num_rows);
+    for (size_t r = 0; r < num_rows; r++)
+    {
+        observations[r] = data+r*row_stride;
+    }
+    this->predictRows_(observations.data(), num_rows, output);
+}
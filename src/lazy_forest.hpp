@@ -0,0 +1,69 @@
+#ifndef LAZY_FOREST_HPP
+#define LAZY_FOREST_HPP
+
+#include "compiled_forest.hpp"
+#include "datasets.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class LazyForest
+{
+    /**
+     * Read-only forest served from a file written by CompiledForest::saveIndexed, without loading it up front:
+     * the file is mapped in memory, and only its header and per-tree offset index are read when opening it.
+     * Each tree is checked (and its pages read from disk) the first time it is used, so a process is ready to predict
+     * within milliseconds, and memory only holds the trees it actually uses.
+     * prefetch loads every tree in a background thread (or in the calling thread) while predictions go on.
+     * Predictions are the same as those of the saved CompiledForest, and can be made concurrently.
+     * */
+
+private:
+
+    // Attributes:
+    std::string filename_;  // Name of mapped file.
+    const char* data_;  // Mapped file.
+    size_t size_;  // Size of mapped file in bytes.
+    bool regression_;  // Use regression==false for a classification forest.
+    int num_features_;  // Number of features in dataset.
+    std::vector<double> classes_;  // Sorted class labels (classification only).
+    std::vector<int64_t> offsets_;  // Position of the first node of each tree in the file.
+    std::vector<int64_t> sizes_;  // Number of nodes of each tree.
+    std::unique_ptr<std::once_flag[]> loaded_;  // Set once each tree is checked.
+    mutable std::atomic<int> num_loaded_;  // Number of trees checked.
+    std::thread prefetcher_;  // Background thread loading all trees (if started).
+    std::atomic<bool> stopping_;  // Tells prefetcher to stop (on destruction).
+
+    // Utilities:
+    const CompiledNode* tree_(int tree) const;  // Nodes of a tree (checked on first use).
+    void load_(int tree) const;  // Check that positions of a tree stay inside it.
+    void predictRows_(const double* const* observations, int n, double* output) const;  // Predict observations, one tree at a time.
+    double aggregate_(const double* sums) const;  // Mean value or majority vote from accumulated sums (or votes).
+
+public:
+
+    // Constructors:
+    LazyForest(std::string filename, bool prefetch=false);
+    LazyForest(const LazyForest&) = delete;
+    LazyForest& operator=(const LazyForest&) = delete;
+    ~LazyForest();
+
+    // Getters:
+    int getNumTrees() const;  // Number of trees.
+    int getNumFeatures() const;  // Number of features in dataset.
+    bool isRegressionTree() const;  // Type of forest (classification or regression).
+    std::vector<double> getClasses() const;  // Sorted class labels (classification only).
+    int getNumLoadedTrees() const;  // Number of trees used (or prefetched) so far.
+
+    // Utilities:
+    void prefetch(bool background=true);  // Load every tree (in a background thread, by default).
+    double predictTree(int tree, const double* observation) const;  // Prediction of one tree for a single observation.
+    double predict(const double* observation) const;  // Prediction of the forest for a single observation.
+    DataVector predict(DataFrame* testdata) const;  // Perform prediction on each observation.
+    void predict(const double* data, size_t num_rows, size_t num_features, size_t row_stride, double* output) const;  // Predict rows of an external row-major buffer.
+
+};
+
+#endif
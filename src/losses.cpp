@@ -16,37 +16,41 @@
 double LossFunction::misclassification_error(DataVector labels)
 {
     /** Returns the loss calculated with misclassification_error. */
+    return this->misclassification_error(LabelCounter(labels));
+}
+
+double LossFunction::cross_entropy(DataVector labels)
+{
+    /** Returns the loss calculated with cross_entropy. */
+    return this->cross_entropy(LabelCounter(labels));
+}
+
+double LossFunction::gini_impurity(DataVector labels)
+{
+    /** Returns the loss calculated with gini_impurity. */
+    return this->gini_impurity(LabelCounter(labels));
+}
+
+double LossFunction::misclassification_error(const LabelCounter& label_counter)
+{
+    /** Returns the loss calculated with misclassification_error (from label counts). */
     double loss;
-    LabelCounter label_counter = LabelCounter(labels);
     int prediction = label_counter.get_most_frequent();
-    int correct = 0;
-    int incorrect = 0;
-    for (int i = 0; i < labels.size(); i++)
-    {
-        if (labels.value(i) == prediction) {
-            correct += 1;
-        } else {
-            incorrect += 1;
-        }
-    }
+    int correct = label_counter.get_count(prediction);
+    int incorrect = label_counter.total_size() - correct;
     loss = 1.0*incorrect/(correct+incorrect);
     return loss;
 }
 
-double LossFunction::cross_entropy(DataVector labels)
+double LossFunction::cross_entropy(const LabelCounter& label_counter)
 {
-    /** Returns the loss calculated with cross_entropy. */
-    double loss;
-    LabelCounter label_counter = LabelCounter(labels);
-    int sum_of_counts = label_counter.get_values().sum();  // Get total number of labels.
-    assert (sum_of_counts==labels.size());
-    int predicted_label = label_counter.get_most_frequent();
-    DataVector labels_ = label_counter.get_labels();  // Get labels.
+    /** Returns the loss calculated with cross_entropy (from label counts). */
+    double loss = 0;
+    int sum_of_counts = label_counter.total_size();  // Get total number of labels.
     DataVector counts_ = label_counter.get_values();  // Get count for each label.
     double prop;  // Temporary variable to store proportion of current class.
     for (int i = 0; i < counts_.size(); i++)
     {
-        int label = labels_.value(i);
         int count = counts_.value(i);
         prop = 1.0*count/sum_of_counts;
         loss += prop * std::log2(prop);
@@ -55,14 +59,11 @@ double LossFunction::cross_entropy(DataVector labels)
     return loss;
 }
 
-double LossFunction::gini_impurity(DataVector labels)
+double LossFunction::gini_impurity(const LabelCounter& label_counter)
 {
-    /** Returns the loss calculated with gini_impurity. */
+    /** Returns the loss calculated with gini_impurity (from label counts). */
     double loss = 0;
-    LabelCounter label_counter = LabelCounter(labels);
-    int sum_of_counts = label_counter.get_values().sum();  // Get total number of labels.
-    assert (sum_of_counts==labels.size());
-    //int predicted_label = label_counter.get_most_frequent();
+    int sum_of_counts = label_counter.total_size();  // Get total number of labels.
     DataVector counts_ = label_counter.get_values();  // Get count for each label (don't actually need the label).
     double prop;  // Temporary variable to store proportion of current class.
     for (int i = 0; i < counts_.size(); i++)
@@ -89,6 +90,39 @@ double LossFunction::mean_squared_error(DataVector labels)
 }
 
 
+double LossFunction::mean_squared_error(DataVector labels, std::vector<int> weights)
+{
+    /**
+     * Returns the mean squared error of a set of labels, counting each label as many times as its (integer) weight.
+     * Sums are accumulated once per unit of weight, so the result is exactly that of mean_squared_error on the labels
+     * with each one repeated in place (and split searches choose the same splits as on duplicated rows).
+     */
+    double prediction = 0;
+    int total_weight = 0;
+    for (int i = 0; i < labels.size(); i++)
+    {
+        for (int k = 0; k < weights[i]; k++)
+        {
+            prediction += labels.value(i);
+        }
+        total_weight += weights[i];
+    }
+    prediction = prediction / total_weight;
+    double loss = 0;
+    double error;
+    for (int i = 0; i < labels.size(); i++)
+    {
+        error = ( labels.value(i) - prediction );
+        for (int k = 0; k < weights[i]; k++)
+        {
+            loss += (error*error);
+        }
+    }
+    loss = 1.0*loss/total_weight;
+    return loss;
+}
+
+
 /**
  * LOSS FUNCTION - ACCESSORS :
  */
@@ -127,6 +161,40 @@ double LossFunction::calculate(DataVector *labels)
     return this->calculate(*labels);
 }
 
+double LossFunction::calculate(DataVector labels, std::vector<int> weights)
+{
+    /** Calculate loss with integer sample weights (each label counted as many times as its weight). */
+    assert (weights.size()==labels.size());
+    double loss;
+    if (this->method_=="mean_squared_error") {
+        assert (labels.size()>0);  // Loss is undefined for empty list.
+        loss = this->mean_squared_error(labels, weights);
+    } else {
+        loss = this->calculate(LabelCounter(labels, weights));
+    }
+    return loss;
+}
+
+double LossFunction::calculate(const LabelCounter& label_counter)
+{
+    /**
+     * Calculate a classification loss directly from label counts
+     * (gives the same result as calculating it from the labels themselves).
+     */
+    assert (label_counter.total_size()>0);  // Loss is undefined for empty list.
+    double loss;
+    if (this->method_=="misclassification_error") {
+        loss = this->misclassification_error(label_counter);
+    } else if (this->method_=="cross_entropy") {
+        loss = this->cross_entropy(label_counter);
+    } else if (this->method_=="gini_impurity") {
+        loss = this->gini_impurity(label_counter);
+    } else {
+        throw std::invalid_argument( "Loss method cannot be calculated from label counts: "+this->method_ );
+    }
+    return loss;
+}
+
 
 /**
  * LOSS FUNCTION - OVERLOADED OPERATORS :
@@ -300,6 +368,41 @@ void LabelCounter::increment(double label)
     this->total_size_ += 1;
 }
 
+void LabelCounter::increment(double label, int count)
+{
+    /** Increment counter for specified class (coerced to integer) by a number of occurrences. */
+    assert (count>=0);
+    if (count==0) { return; }  // Labels with no occurrences are not counted.
+    int key = this->convert_to_key(label);
+    if (this->counts_.find(key) == this->counts_.end()) {
+        counts_.insert({key,count});
+    } else {
+        counts_.at(key) += count;
+    }
+    this->total_size_ += count;
+}
+
+void LabelCounter::decrement(double label)
+{
+    /** Decrement counter for specified class (removing the label once its count reaches zero). */
+    this->decrement(label, 1);
+}
+
+void LabelCounter::decrement(double label, int count)
+{
+    /** Decrement counter for specified class by a number of occurrences (removing the label once its count reaches zero). */
+    assert (count>=0);
+    if (count==0) { return; }
+    int key = this->convert_to_key(label);
+    assert (this->counts_.find(key) != this->counts_.end());  // Label must have been counted.
+    assert (counts_.at(key) >= count);
+    counts_.at(key) -= count;
+    if (counts_.at(key) == 0) {
+        counts_.erase(key);
+    }
+    this->total_size_ -= count;
+}
+
 void LabelCounter::increment(DataVector labels)
 {
     /** Increment counter for a vector of labels. */
@@ -315,6 +418,16 @@ void LabelCounter::increment(DataVector *labels)
     this->increment( *labels );
 }
 
+void LabelCounter::increment(DataVector labels, std::vector<int> weights)
+{
+    /** Increment counter for a vector of labels, counting each label as many times as its (integer) weight. */
+    assert (weights.size()==labels.size());
+    for (int i = 0; i < labels.size(); i++)
+    {
+        this->increment( labels.value(i), weights[i] );
+    }
+}
+
 
 /*
  * CLASSCOUNTER - OVERLOADED OPERATORS
@@ -360,3 +473,10 @@ LabelCounter::LabelCounter(DataVector *labels)
     this->total_size_ = 0;
     this->increment(*labels);
 }
+
+LabelCounter::LabelCounter(DataVector labels, std::vector<int> weights)
+{
+    /** Initialize counter from given vector, counting each label as many times as its (integer) weight. */
+    this->total_size_ = 0;
+    this->increment(labels, weights);
+}
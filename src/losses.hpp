@@ -5,6 +5,8 @@
 #include <string>
 #include <map>
 
+class LabelCounter;
+
 class LossFunction
 {
     /** 
@@ -21,6 +23,10 @@ private:
     double cross_entropy(DataVector labels);
     double gini_impurity(DataVector labels);
     double mean_squared_error(DataVector labels);
+    double mean_squared_error(DataVector labels, std::vector<int> weights);
+    double misclassification_error(const LabelCounter& label_counter);
+    double cross_entropy(const LabelCounter& label_counter);
+    double gini_impurity(const LabelCounter& label_counter);
 
 public:
 
@@ -30,6 +36,8 @@ public:
     // Utilities:
     double calculate(DataVector labels);
     double calculate(DataVector *labels);
+    double calculate(DataVector labels, std::vector<int> weights);  // Loss with integer sample weights.
+    double calculate(const LabelCounter& label_counter);  // Classification loss from label counts.
 
     // Overloaded operators:
 
@@ -70,8 +78,12 @@ public:
     // Utilities:
     void reset();  // Reset counters to zero.
     void increment(double label);  // Increment counter for specified label (coerced to integer).
+    void increment(double label, int count);  // Increment counter for specified label by a number of occurrences.
+    void decrement(double label);  // Decrement counter for specified label (removed when it reaches zero).
+    void decrement(double label, int count);  // Decrement counter for specified label by a number of occurrences.
     void increment(DataVector labels);  // Increment counter for a vector of labels.
     void increment(DataVector *labels);  // Increment counter for a vector (pointer) of labels.
+    void increment(DataVector labels, std::vector<int> weights);  // Increment counter for a vector of labels with integer weights.
 
     // Overloaded operators:
     friend std::ostream& operator<<(std::ostream& os, const LabelCounter& labelcounter);  // Print label counts.
@@ -80,6 +92,7 @@ public:
     LabelCounter();  // Initialize counter with no counts.
     LabelCounter(DataVector labels);  // Initialize counter from given vector.
     LabelCounter(DataVector *labels);  // Initialize counter from given vector (pointer).
+    LabelCounter(DataVector labels, std::vector<int> weights);  // Initialize counter from given vector with integer weights.
 
 };
 
@@ -0,0 +1,151 @@
+#include "prediction_cache.hpp"
+#include "random_forest.hpp"
+#include "datasets.hpp"
+#include <assert.h>
+#include <cmath>
+#include <cstring>
+
+// Constructors:
+PredictionCache::PredictionCache(const RandomForest& forest, size_t capacity, int num_shards, double resolution)
+    : forest_(forest), shards_(num_shards)
+{
+    /**
+     * Cache in front of a fitted RandomForest.
+     *    forest     : Fitted RandomForest (must outlive the cache).
+     *    capacity   : Largest number of cached predictions (split evenly between shards).
+     *    num_shards : Number of independently locked parts of the cache.
+     *    resolution : Round feature values down to a multiple of this before lookup (or 0 for exact keys).
+     */
+    assert (forest.isFitted());
+    assert (num_shards>0);
+    assert (capacity>=num_shards);
+    assert (resolution>=0);
+    this->num_features_ = forest.getDataFrame().width()-1;  // Number of columns, excluding label column.
+    this->shard_capacity_ = capacity / num_shards;
+    this->resolution_ = resolution;
+    for (Shard& shard : this->shards_)
+    {
+        shard.hits = 0;
+        shard.misses = 0;
+    }
+}
+
+// Getters:
+long PredictionCache::getHits() const
+{
+    /** Number of predictions answered from the cache. */
+    long hits = 0;
+    for (const Shard& shard : this->shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        hits += shard.hits;
+    }
+    return hits;
+}
+
+long PredictionCache::getMisses() const
+{
+    /** Number of predictions computed by the forest. */
+    long misses = 0;
+    for (const Shard& shard : this->shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        misses += shard.misses;
+    }
+    return misses;
+}
+
+size_t PredictionCache::getSize() const
+{
+    /** Number of cached predictions. */
+    size_t size = 0;
+    for (const Shard& shard : this->shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        size += shard.entries.size();
+    }
+    return size;
+}
+
+// Utilities:
+uint64_t PredictionCache::key_(const double* features, std::vector<double>& key) const
+{
+    /** Copy the (rounded) feature values of an observation into `key`, and return a hash of their bits. */
+    key.resize(this->num_features_);
+    uint64_t hash = 0xcbf29ce484222325;
+    for (int f = 0; f < this->num_features_; f++)
+    {
+        key[f] = (this->resolution_>0) ? std::floor(features[f]/this->resolution_) : features[f];
+        uint64_t bits;
+        std::memcpy(&bits, &key[f], sizeof(bits));
+        // Mix in each value (multiply-xorshift, so that every bit affects the shard and bucket bits):
+        hash = (hash ^ bits) * 0x9e3779b97f4a7c15;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+double PredictionCache::predict(const double* features, size_t n)
+{
+    /**
+     * Prediction for a single observation given as raw values (features[0],...,features[n-1]):
+     * from the cache if its key is there, otherwise from the forest (then cached, evicting the least recently used
+     * entry of the shard if it is full). The forest runs outside of the lock.
+     */
+    assert ( (n==this->num_features_) or (n==this->num_features_+1) );
+    thread_local std::vector<double> key;
+    uint64_t hash = this->key_(features, key);
+    Shard& shard = this->shards_[(hash>>32) % this->shards_.size()];  // High bits (low bits select buckets).
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(hash);
+        // Same hash with different values is a miss (the entry is replaced below); bits are compared, so missing values match:
+        if ( (found!=shard.index.end()) and (std::memcmp(found->second->key.data(), key.data(), key.size()*sizeof(double))==0) ) {
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);  // Most recently used.
+            shard.hits++;
+            return found->second->prediction;
+        }
+        shard.misses++;
+    }
+    double prediction = this->forest_.predict_one(features, n);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(hash);
+    if (found!=shard.index.end()) {
+        // Another thread cached it meanwhile (or it is a colliding key): replace it.
+        shard.entries.erase(found->second);
+        shard.index.erase(found);
+    }
+    if (shard.entries.size()>=this->shard_capacity_) {
+        // Evict least recently used entry:
+        shard.index.erase(shard.entries.back().hash);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front({hash, key, prediction});
+    shard.index[hash] = shard.entries.begin();
+    return prediction;
+}
+
+DataVector PredictionCache::predict(DataFrame* testdata)
+{
+    /** Perform prediction on each observation (through the cache) and collect a vector of predictions. */
+    assert ( (testdata->width()==this->num_features_) or (testdata->width()==this->num_features_+1) );
+    std::vector<double> predictions(testdata->length());
+    for (int j = 0; j < testdata->length(); j++)
+    {
+        predictions[j] = this->predict(testdata->row(j)->data(), testdata->width());
+    }
+    return DataVector(predictions, false);  // is_row=false.
+}
+
+void PredictionCache::clear()
+{
+    /** Remove all entries and reset counters. */
+    for (Shard& shard : this->shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries.clear();
+        shard.index.clear();
+        shard.hits = 0;
+        shard.misses = 0;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef PREDICTION_CACHE_HPP
+#define PREDICTION_CACHE_HPP
+
+#include "random_forest.hpp"
+#include "datasets.hpp"
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+class PredictionCache
+{
+    /**
+     * Bounded cache of RandomForest predictions, keyed by the feature vector of each observation.
+     * Entries are spread over shards by a hash of the key (each shard has its own lock, and evicts its least
+     * recently used entry when full), so threads predicting different observations rarely wait for each other.
+     * Keys are compared in full, so a hash collision is a miss, never a wrong prediction.
+     * With a resolution, values are rounded down to a multiple of it before lookup, so nearby observations
+     * share the prediction of the first one seen (exact predictions otherwise).
+     * The forest must outlive the cache and not be refitted while it is used.
+     * */
+
+private:
+
+    // A cached prediction:
+    struct Entry
+    {
+        uint64_t hash;  // Hash of key.
+        std::vector<double> key;  // Feature values (rounded, with a resolution).
+        double prediction;  // Prediction of the forest.
+    };
+
+    // An independently locked part of the cache:
+    struct Shard
+    {
+        mutable std::mutex mutex;  // Protects everything below.
+        std::list<Entry> entries;  // Entries, most recently used first.
+        std::unordered_map<uint64_t,std::list<Entry>::iterator> index;  // Entry of each key hash.
+        long hits;  // Number of lookups answered from this shard.
+        long misses;  // Number of lookups not found in this shard.
+    };
+
+    // Attributes:
+    const RandomForest& forest_;  // Forest whose predictions are cached.
+    int num_features_;  // Number of features in dataset.
+    size_t shard_capacity_;  // Largest number of entries in each shard.
+    double resolution_;  // Rounding step of feature values (or 0 for exact keys).
+    std::vector<Shard> shards_;  // Parts of the cache, selected by key hash.
+
+    // Utilities:
+    uint64_t key_(const double* features, std::vector<double>& key) const;  // Fill key of an observation, and return its hash.
+
+public:
+
+    // Constructors:
+    PredictionCache(const RandomForest& forest, size_t capacity=100000, int num_shards=16, double resolution=0);
+
+    // Getters:
+    long getHits() const;  // Number of predictions answered from the cache.
+    long getMisses() const;  // Number of predictions computed by the forest.
+    size_t getSize() const;  // Number of cached predictions.
+
+    // Utilities:
+    double predict(const double* features, size_t n);  // Prediction for a single observation given as raw values.
+    DataVector predict(DataFrame* testdata);  // Perform prediction on each observation.
+    void clear();  // Remove all entries and reset counters.
+
+};
+
+#endif
@@ -0,0 +1,419 @@
+#include "prediction_server.hpp"
+#include "compiled_forest.hpp"
+#include "forest_handle.hpp"
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// Largest number of observations accepted in one request:
+#define PREDICTION_SERVER_MAX_REQUEST_ROWS (1<<24)
+// Number of most recent requests whose latency is kept for percentiles:
+#define PREDICTION_SERVER_LATENCY_WINDOW 10000
+
+/*
+ * SOCKET HELPERS :
+ */
+
+static bool is_tcp(std::string address){
+    /** Addresses "tcp:<port>" are loopback TCP ports, anything else is a Unix socket path. */
+    return address.compare(0, 4, "tcp:")==0;
+}
+
+static int open_socket(std::string address, bool listening){
+    /** Open a stream socket listening on (or connected to) the given address, or throw. */
+    int fd;
+    int result;
+    if (is_tcp(address)) {
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(std::stoi(address.substr(4)));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd<0) {
+            throw std::runtime_error( std::string("Could not create socket: ")+std::strerror(errno) );
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // Send small responses right away.
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            result = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        } else {
+            result = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        }
+    } else {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (address.size()>=sizeof(addr.sun_path)) {
+            throw std::invalid_argument( "Unix socket path is too long: "+address );
+        }
+        std::strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path)-1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd<0) {
+            throw std::runtime_error( std::string("Could not create socket: ")+std::strerror(errno) );
+        }
+        if (listening) {
+            unlink(address.c_str());  // Remove socket file left by a previous server.
+            result = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        } else {
+            result = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        }
+    }
+    if ( (result==0) and listening ) {
+        result = listen(fd, 128);
+    }
+    if (result!=0) {
+        std::string error = std::strerror(errno);
+        close(fd);
+        throw std::runtime_error( "Could not "+std::string(listening ? "listen on " : "connect to ")+address+": "+error );
+    }
+    return fd;
+}
+
+static bool read_all(int fd, void* buffer, size_t size){
+    /** Read exactly size bytes (false if the connection is closed first). */
+    char* bytes = static_cast<char*>(buffer);
+    while (size>0)
+    {
+        ssize_t n = recv(fd, bytes, size, 0);
+        if ( (n<0) and (errno==EINTR) ) { continue; }
+        if (n<=0) { return false; }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const void* buffer, size_t size){
+    /** Write exactly size bytes (false if the connection is closed first). */
+    const char* bytes = static_cast<const char*>(buffer);
+    while (size>0)
+    {
+        ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+        if ( (n<0) and (errno==EINTR) ) { continue; }
+        if (n<=0) { return false; }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Constructors:
+PredictionServer::PredictionServer(std::shared_ptr<const CompiledForest> forest, std::string address, int num_threads, int max_batch_rows, int max_wait_us)
+    : forest_(forest)
+{
+    /**
+     * Server for a forest (call start to listen).
+     *    forest         : Compiled forest to predict with.
+     *    address        : Unix socket path, or "tcp:<port>" for a loopback TCP port.
+     *    num_threads    : Number of worker threads scoring batches.
+     *    max_batch_rows : Largest number of observations in a batch (a larger request is scored alone).
+     *    max_wait_us    : Longest wait for more requests after the first one of a batch arrives (microseconds).
+     */
+    assert (forest!=nullptr);
+    assert (forest->getNumTrees()>0);
+    assert (num_threads>0);
+    assert (max_batch_rows>0);
+    assert (max_wait_us>=0);
+    this->address_ = address;
+    this->num_threads_ = num_threads;
+    this->max_batch_rows_ = max_batch_rows;
+    this->max_wait_us_ = max_wait_us;
+    this->listen_fd_ = -1;
+    this->running_ = false;
+    this->queued_rows_ = 0;
+    this->num_connections_ = 0;
+    this->requests_ = 0;
+    this->rows_ = 0;
+    this->batches_ = 0;
+    this->latencies_us_.reserve(PREDICTION_SERVER_LATENCY_WINDOW);
+    this->next_latency_ = 0;
+}
+
+PredictionServer::~PredictionServer()
+{
+    /** Stop server (if running). */
+    this->stop();
+}
+
+// Getters:
+ServerStats PredictionServer::getStats() const
+{
+    /** Counters since the server was started, and latency percentiles (nearest rank) of the most recent requests. */
+    std::vector<double> latencies;
+    ServerStats stats;
+    {
+        std::lock_guard<std::mutex> lock(this->stats_mutex_);
+        stats.requests = this->requests_;
+        stats.rows = this->rows_;
+        stats.batches = this->batches_;
+        latencies = this->latencies_us_;
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-this->started_).count();
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        if (latencies.size()==0) { return 0.0; }
+        int rank = std::ceil(p*latencies.size());
+        return latencies[std::max(rank, 1)-1];
+    };
+    stats.p50_us = percentile(0.50);
+    stats.p90_us = percentile(0.90);
+    stats.p99_us = percentile(0.99);
+    return stats;
+}
+
+std::shared_ptr<const CompiledForest> PredictionServer::getForest() const
+{
+    /** Forest currently used for prediction. */
+    return this->forest_.load();
+}
+
+bool PredictionServer::isRunning() const
+{
+    /** Indicates whether the server accepts and scores requests. */
+    return this->running_;
+}
+
+// Utilities:
+void PredictionServer::start()
+{
+    /** Listen on the address, and start accepting connections and scoring requests. */
+    assert (!this->running_);
+    this->listen_fd_ = open_socket(this->address_, true);
+    this->running_ = true;
+    this->started_ = std::chrono::steady_clock::now();
+    for (int i = 0; i < this->num_threads_; i++)
+    {
+        this->workers_.emplace_back(&PredictionServer::work_, this);
+    }
+    this->acceptor_ = std::thread(&PredictionServer::accept_, this);
+}
+
+void PredictionServer::stop()
+{
+    /** Stop accepting connections, answer requests already queued, close all connections and join threads. */
+    {
+        std::lock_guard<std::mutex> lock(this->queue_mutex_);
+        if (!this->running_) {
+            return;
+        }
+        this->running_ = false;
+    }
+    this->queue_cv_.notify_all();
+    // Wake up the acceptor:
+    shutdown(this->listen_fd_, SHUT_RDWR);
+    this->acceptor_.join();
+    close(this->listen_fd_);
+    this->listen_fd_ = -1;
+    if (!is_tcp(this->address_)) {
+        unlink(this->address_.c_str());
+    }
+    // Workers answer requests already queued, then exit:
+    for (std::thread& worker : this->workers_)
+    {
+        worker.join();
+    }
+    this->workers_.clear();
+    // Wake up connections waiting for requests, and wait for their threads to finish:
+    std::unique_lock<std::mutex> lock(this->queue_mutex_);
+    for (int fd : this->connection_fds_)
+    {
+        shutdown(fd, SHUT_RDWR);
+    }
+    this->connections_cv_.wait(lock, [this] { return this->num_connections_==0; });
+}
+
+std::shared_ptr<const CompiledForest> PredictionServer::swapForest(std::shared_ptr<const CompiledForest> forest)
+{
+    /**
+     * Replace the forest while serving (e.g. after retraining), without locking out the workers:
+     * batches taken from now on use the new forest. It must have the same number of features, since queued
+     * requests were checked against the old one. Returns the previous forest.
+     */
+    assert (forest!=nullptr);
+    assert (forest->getNumTrees()>0);
+    if (forest->getNumFeatures()!=this->forest_.load()->getNumFeatures()) {
+        throw std::invalid_argument( "Replacement forest must have the same number of features ("+std::to_string(this->forest_.load()->getNumFeatures())+")." );
+    }
+    return this->forest_.swap(forest);
+}
+
+void PredictionServer::accept_()
+{
+    /**
+     * Accept connections until the server is stopped. Each connection is read by its own detached thread,
+     * which ends with the connection, so threads of closed connections do not pile up in a long-running server.
+     */
+    while (this->running_)
+    {
+        int fd = accept(this->listen_fd_, nullptr, nullptr);
+        if (fd<0) {
+            if ( (errno==EINTR) or (errno==ECONNABORTED) ) { continue; }
+            break;  // Listening socket was shut down.
+        }
+        if (is_tcp(this->address_)) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        std::lock_guard<std::mutex> lock(this->queue_mutex_);
+        if (!this->running_) {
+            close(fd);
+            break;
+        }
+        this->connection_fds_.push_back(fd);
+        this->num_connections_++;
+        std::thread(&PredictionServer::serve_, this, fd).detach();
+    }
+}
+
+void PredictionServer::serve_(int fd)
+{
+    /** Read requests from a connection, queue each one, and write its predictions once scored. */
+    uint32_t num_features = this->forest_.load()->getNumFeatures();  // Same for every forest swapped in.
+    while (true)
+    {
+        uint32_t header[2];
+        if (!read_all(fd, header, sizeof(header))) { break; }
+        if ( (header[1]!=num_features) or (header[0]>PREDICTION_SERVER_MAX_REQUEST_ROWS) ) { break; }
+        Request request;
+        request.num_rows = header[0];
+        request.features.resize(size_t(header[0])*num_features);
+        if (!read_all(fd, request.features.data(), request.features.size()*sizeof(double))) { break; }
+        request.arrival = std::chrono::steady_clock::now();
+        std::future<void> done = request.done.get_future();
+        {
+            std::lock_guard<std::mutex> lock(this->queue_mutex_);
+            if (!this->running_) { break; }
+            this->queue_.push_back(&request);
+            this->queued_rows_ += request.num_rows;
+        }
+        this->queue_cv_.notify_one();
+        done.wait();
+        uint32_t num_rows = request.num_rows;
+        if (!write_all(fd, &num_rows, sizeof(num_rows))) { break; }
+        if (!write_all(fd, request.predictions.data(), request.predictions.size()*sizeof(double))) { break; }
+    }
+    std::lock_guard<std::mutex> lock(this->queue_mutex_);
+    this->connection_fds_.erase(std::find(this->connection_fds_.begin(), this->connection_fds_.end(), fd));
+    close(fd);
+    this->num_connections_--;
+    this->connections_cv_.notify_all();  // Under the lock: stop cannot return (and the server be destroyed) before this.
+}
+
+void PredictionServer::work_()
+{
+    /**
+     * Take batches of queued requests and score them, until the server is stopped and the queue is empty.
+     * Once a request is queued, wait up to max_wait_us_ (from its arrival) for max_batch_rows_ observations.
+     */
+    while (true)
+    {
+        std::vector<Request*> batch;
+        {
+            std::unique_lock<std::mutex> lock(this->queue_mutex_);
+            this->queue_cv_.wait(lock, [this] { return (this->queue_.size()>0) or (!this->running_); });
+            if (this->queue_.size()==0) {
+                return;  // Stopped, and nothing left to answer.
+            }
+            std::chrono::steady_clock::time_point deadline = this->queue_.front()->arrival + std::chrono::microseconds(this->max_wait_us_);
+            this->queue_cv_.wait_until(lock, deadline, [this] { return (this->queued_rows_>=this->max_batch_rows_) or (!this->running_); });
+            // Take requests in arrival order (at least one, even if it is larger than a batch):
+            int batch_rows = 0;
+            while ( (this->queue_.size()>0) and ( (batch.size()==0) or (batch_rows+this->queue_.front()->num_rows<=this->max_batch_rows_) ) )
+            {
+                batch.push_back(this->queue_.front());
+                batch_rows += this->queue_.front()->num_rows;
+                this->queued_rows_ -= this->queue_.front()->num_rows;
+                this->queue_.pop_front();
+            }
+        }
+        if (batch.size()>0) {
+            this->score_(batch);
+        }
+    }
+}
+
+void PredictionServer::score_(std::vector<Request*>& batch)
+{
+    /** Copy the observations of all requests of a batch into one buffer, predict them at once, and answer each request. */
+    std::shared_ptr<const CompiledForest> forest = this->forest_.load();  // Kept for the whole batch, even if swapped meanwhile.
+    size_t num_features = forest->getNumFeatures();
+    size_t num_rows = 0;
+    for (Request* request : batch)
+    {
+        num_rows += request->num_rows;
+    }
+    std::vector<double> features;
+    features.reserve(num_rows*num_features);
+    for (Request* request : batch)
+    {
+        features.insert(features.end(), request->features.begin(), request->features.end());
+    }
+    std::vector<double> predictions(num_rows);
+    if (num_rows>0) {
+        forest->predict(features.data(), num_rows, num_features, num_features, predictions.data());
+    }
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(this->stats_mutex_);
+        this->requests_ += batch.size();
+        this->rows_ += num_rows;
+        this->batches_ += 1;
+        for (Request* request : batch)
+        {
+            double latency = std::chrono::duration<double,std::micro>(now-request->arrival).count();
+            if (this->latencies_us_.size()<PREDICTION_SERVER_LATENCY_WINDOW) {
+                this->latencies_us_.push_back(latency);
+            } else {
+                this->latencies_us_[this->next_latency_] = latency;  // Replace the oldest latency.
+            }
+            this->next_latency_ = (this->next_latency_+1)%PREDICTION_SERVER_LATENCY_WINDOW;
+        }
+    }
+    size_t start = 0;
+    for (Request* request : batch)
+    {
+        request->predictions.assign(predictions.begin()+start, predictions.begin()+start+request->num_rows);
+        start += request->num_rows;
+        request->done.set_value();  // Request may be destroyed from here on.
+    }
+}
+
+// Client:
+PredictionClient::PredictionClient(std::string address)
+{
+    /** Connect to a PredictionServer listening on the given address (Unix socket path, or "tcp:<port>"). */
+    this->fd_ = open_socket(address, false);
+}
+
+PredictionClient::~PredictionClient()
+{
+    /** Close connection. */
+    close(this->fd_);
+}
+
+void PredictionClient::predict(const double* data, int num_rows, int num_features, double* output)
+{
+    /** Send observations (num_rows x num_features, row-major) and write their predictions to output[0],...,output[num_rows-1]. */
+    assert (num_rows>=0);
+    uint32_t header[2] = {uint32_t(num_rows), uint32_t(num_features)};
+    uint32_t num_predictions;
+    bool ok = write_all(this->fd_, header, sizeof(header))
+        and write_all(this->fd_, data, size_t(num_rows)*num_features*sizeof(double))
+        and read_all(this->fd_, &num_predictions, sizeof(num_predictions))
+        and (num_predictions==uint32_t(num_rows))
+        and read_all(this->fd_, output, size_t(num_rows)*sizeof(double));
+    if (!ok) {
+        throw std::runtime_error( "Connection to PredictionServer was closed (wrong number of features?)." );
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef PREDICTION_SERVER_HPP
+#define PREDICTION_SERVER_HPP
+
+#include "compiled_forest.hpp"
+#include "forest_handle.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+/*
+ * PROTOCOL :
+ * Clients send requests over a stream socket (Unix domain socket, or loopback TCP with an address "tcp:<port>"),
+ * and get one response per request, in order:
+ *    request  : uint32 num_rows, uint32 num_features, then num_rows*num_features doubles (row-major).
+ *    response : uint32 num_rows, then num_rows doubles (predictions).
+ * A request with the wrong number of features closes the connection.
+ */
+
+struct ServerStats
+{
+    /**
+     * Counters and latency percentiles of a PredictionServer (latency: from receiving a request to its predictions).
+     * Percentiles are taken over the 10000 most recent requests only (PREDICTION_SERVER_LATENCY_WINDOW), so memory stays bounded.
+     * */
+    long requests;  // Number of requests answered.
+    long rows;  // Number of observations predicted.
+    long batches;  // Number of batches scored.
+    double seconds;  // Time since the server was started.
+    double p50_us;  // Median latency (microseconds).
+    double p90_us;  // 90th percentile of latency (microseconds).
+    double p99_us;  // 99th percentile of latency (microseconds).
+};
+
+class PredictionServer
+{
+    /**
+     * Scoring daemon for a CompiledForest: one thread per connection reads requests into a shared queue,
+     * and a pool of worker threads coalesces queued requests into micro-batches (up to max_batch_rows observations,
+     * waiting at most max_wait_us for more after the first one arrives) and predicts each batch at once.
+     * The forest can be replaced while serving (see swapForest): batches already being scored finish with the old one.
+     * */
+
+private:
+
+    // A request waiting for its predictions:
+    struct Request
+    {
+        std::vector<double> features;  // Observations (row-major).
+        int num_rows;  // Number of observations.
+        std::vector<double> predictions;  // Filled by a worker.
+        std::chrono::steady_clock::time_point arrival;  // When the request was received.
+        std::promise<void> done;  // Set once predictions are filled.
+    };
+
+    // Attributes:
+    ForestHandle forest_;  // Forest used for prediction (read-only, shared by workers, replaceable while serving).
+    std::string address_;  // Unix socket path, or "tcp:<port>" for loopback TCP.
+    int num_threads_;  // Number of worker threads.
+    int max_batch_rows_;  // Largest number of observations in a batch.
+    int max_wait_us_;  // Longest wait for more requests after the first one of a batch (microseconds).
+    int listen_fd_;  // Listening socket (or -1 when stopped).
+    std::atomic<bool> running_;  // State variable: Flag indicating whether the server accepts and scores requests.
+    std::chrono::steady_clock::time_point started_;  // When the server was started.
+    std::thread acceptor_;  // Thread accepting connections.
+    std::vector<std::thread> workers_;  // Threads scoring batches.
+    int num_connections_;  // Number of (detached) threads reading requests from a connection.
+    std::condition_variable connections_cv_;  // Signals the end of a connection thread (to stop).
+    std::vector<int> connection_fds_;  // Sockets of open connections.
+    std::deque<Request*> queue_;  // Requests waiting to be scored.
+    long queued_rows_;  // Number of observations in queued requests.
+    std::mutex queue_mutex_;  // Protects queue_, num_connections_ and connection_fds_.
+    std::condition_variable queue_cv_;  // Signals new requests (or stop) to workers.
+    mutable std::mutex stats_mutex_;  // Protects counters and latencies.
+    long requests_;  // Number of requests answered.
+    long rows_;  // Number of observations predicted.
+    long batches_;  // Number of batches scored.
+    std::vector<double> latencies_us_;  // Latency of the most recent requests answered (ring buffer, microseconds).
+    size_t next_latency_;  // Position of the next latency in latencies_us_ (once full, overwrites the oldest one).
+
+    // Utilities:
+    void accept_();  // Accept connections until stopped.
+    void serve_(int fd);  // Read requests from a connection and write their predictions.
+    void work_();  // Collect batches of requests and score them until stopped.
+    void score_(std::vector<Request*>& batch);  // Predict all requests of a batch at once.
+
+public:
+
+    // Constructors:
+    PredictionServer(
+        std::shared_ptr<const CompiledForest> forest, std::string address,
+        int num_threads=2, int max_batch_rows=256, int max_wait_us=200
+    );
+    ~PredictionServer();
+
+    // Getters:
+    ServerStats getStats() const;  // Counters since start, and latency percentiles of recent requests.
+    std::shared_ptr<const CompiledForest> getForest() const;  // Forest currently used for prediction.
+    bool isRunning() const;  // Indicates whether the server accepts and scores requests.
+
+    // Utilities:
+    void start();  // Listen on the address and start threads.
+    void stop();  // Close all connections and join threads.
+    std::shared_ptr<const CompiledForest> swapForest(std::shared_ptr<const CompiledForest> forest);  // Replace forest without stopping (returns the previous one).
+
+};
+
+class PredictionClient
+{
+    /** Connection to a PredictionServer (one request at a time). */
+
+private:
+
+    // Attributes:
+    int fd_;  // Connected socket.
+
+public:
+
+    // Constructors:
+    PredictionClient(std::string address);
+    ~PredictionClient();
+    PredictionClient(const PredictionClient&) = delete;
+    PredictionClient& operator=(const PredictionClient&) = delete;
+
+    // Utilities:
+    void predict(const double* data, int num_rows, int num_features, double* output);  // Send rows (row-major), receive predictions.
+
+};
+
+#endif
@@ -0,0 +1,288 @@
+#include "quantized_forest.hpp"
+#include "random_forest.hpp"
+#include "decision_tree.hpp"
+#include "tree_node.hpp"
+#include "datasets.hpp"
+#include <assert.h>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+// Feature index marking leaves (and largest number of features plus one):
+#define QUANTIZED_FOREST_LEAF 0xFFFF
+
+// Constructors:
+QuantizedForest::QuantizedForest(const RandomForest& forest)
+{
+    /**
+     * Quantize the trees of a fitted RandomForest.
+     *    forest : Fitted RandomForest.
+     */
+    assert (forest.isFitted());
+    this->regression_ = forest.isRegressionTree();
+    this->num_features_ = forest.getDataFrame().width()-1;  // Number of columns, excluding label column.
+    assert (this->num_features_<QUANTIZED_FOREST_LEAF);
+    this->classes_ = forest.getClasses();
+    this->block_size_ = 256;
+    this->thresholds_ = std::vector<std::vector<double>>(this->num_features_);
+    std::vector<TreeNode*> roots = forest.getRoots();
+    for (TreeNode* root : roots)
+    {
+        this->collect_(root);
+    }
+    this->sortThresholds_();
+    for (TreeNode* root : roots)
+    {
+        this->roots_.push_back(this->compile_(root));
+    }
+}
+
+QuantizedForest::QuantizedForest(const DecisionTree& tree)
+{
+    /**
+     * Quantize a fitted DecisionTree (as a forest of one tree).
+     *    tree : Fitted DecisionTree.
+     */
+    assert (tree.isFitted());
+    this->regression_ = tree.isRegressionTree();
+    this->num_features_ = tree.getDataFrame().width()-1;  // Number of columns, excluding label column.
+    assert (this->num_features_<QUANTIZED_FOREST_LEAF);
+    this->classes_ = tree.getClasses();
+    this->block_size_ = 256;
+    this->thresholds_ = std::vector<std::vector<double>>(this->num_features_);
+    this->collect_(tree.getRoot());
+    this->sortThresholds_();
+    this->roots_.push_back(this->compile_(tree.getRoot()));
+}
+
+// Getters:
+int QuantizedForest::getNumTrees() const
+{
+    /** Number of trees. */
+    return this->roots_.size();
+}
+
+int QuantizedForest::getNumNodes() const
+{
+    /** Number of nodes in all trees. */
+    return this->nodes_.size();
+}
+
+int QuantizedForest::getNumFeatures() const
+{
+    /** Number of features in dataset. */
+    return this->num_features_;
+}
+
+bool QuantizedForest::isRegressionTree() const
+{
+    /** Type of forest (classification or regression). */
+    return this->regression_;
+}
+
+std::vector<double> QuantizedForest::getClasses() const
+{
+    /** Sorted class labels (classification only). */
+    return this->classes_;
+}
+
+std::vector<double> QuantizedForest::getThresholds(int feature) const
+{
+    /** Sorted unique thresholds used to split on a feature (the threshold of bin i is thresholds[i]). */
+    assert ( (feature>=0) and (feature<this->num_features_) );
+    return this->thresholds_[feature];
+}
+
+size_t QuantizedForest::getModelBytes() const
+{
+    /** Memory used by nodes, roots, leaf values and threshold tables (what prediction reads). */
+    size_t bytes = this->nodes_.size()*sizeof(QuantizedNode) + this->roots_.size()*sizeof(uint32_t);
+    bytes += this->leaf_values_.size()*sizeof(double) + this->leaf_votes_.size()*sizeof(int);
+    for (const std::vector<double>& table : this->thresholds_)
+    {
+        bytes += table.size()*sizeof(double);
+    }
+    return bytes;
+}
+
+// Setters:
+void QuantizedForest::setBlockSize(int block_size)
+{
+    /** Number of observations encoded and predicted together by all trees (small enough to stay in cache). */
+    assert (block_size>0);
+    this->block_size_ = block_size;
+}
+
+// Utilities:
+void QuantizedForest::collect_(TreeNode* node)
+{
+    /** Add the splitting thresholds of the subtree rooted at given node to the table of their feature. */
+    assert (node!=nullptr);
+    if (node->isLeaf()) {
+        return;
+    }
+    assert (!std::isnan(node->getSplitThreshold()));
+    this->thresholds_[node->getSplitFeature()].push_back(node->getSplitThreshold());
+    this->collect_(node->getLeft());
+    this->collect_(node->getRight());
+}
+
+void QuantizedForest::sortThresholds_()
+{
+    /** Sort the threshold table of each feature and remove duplicates (bin ids must fit in 16 bits). */
+    for (std::vector<double>& table : this->thresholds_)
+    {
+        std::sort(table.begin(), table.end());
+        table.erase(std::unique(table.begin(), table.end()), table.end());
+        // Missing values are encoded as the number of thresholds:
+        if (table.size()>UINT16_MAX) {
+            throw std::invalid_argument( "QuantizedForest supports at most 65535 thresholds per feature." );
+        }
+    }
+}
+
+uint32_t QuantizedForest::compile_(TreeNode* node)
+{
+    /** Append subtree rooted at given node in depth-first order (left child next to its parent), and return its position. */
+    assert (node!=nullptr);
+    uint32_t position = this->nodes_.size();
+    QuantizedNode quantized;
+    if (node->isLeaf()) {
+        quantized.feature = QUANTIZED_FOREST_LEAF;
+        quantized.bin = 0;
+        quantized.right = this->leaf_values_.size();
+        this->leaf_values_.push_back(node->getPrediction());
+        if (!this->regression_) {
+            this->leaf_votes_.push_back(std::lower_bound(this->classes_.begin(), this->classes_.end(), node->getPrediction()) - this->classes_.begin());
+        }
+        this->nodes_.push_back(quantized);
+    } else {
+        const std::vector<double>& table = this->thresholds_[node->getSplitFeature()];
+        quantized.feature = node->getSplitFeature();
+        quantized.bin = std::lower_bound(table.begin(), table.end(), node->getSplitThreshold()) - table.begin();
+        this->nodes_.push_back(quantized);
+        this->compile_(node->getLeft());
+        // Vector may grow while appending children, so set position by index:
+        uint32_t right = this->compile_(node->getRight());
+        this->nodes_[position].right = right;
+    }
+    return position;
+}
+
+void QuantizedForest::encode(const double* observation, size_t n, uint16_t* bins) const
+{
+    /**
+     * Map the raw values of an observation (observation[0],...,observation[n-1], possibly followed by its label)
+     * to bin ids: the number of thresholds of each feature that are below its value (bins must have room for
+     * one id per feature). Missing values get the number of thresholds, so they go right at every split.
+     */
+    assert ( (n==this->num_features_) or (n==this->num_features_+1) );
+    for (int f = 0; f < this->num_features_; f++)
+    {
+        const std::vector<double>& table = this->thresholds_[f];
+        if (std::isnan(observation[f])) {
+            bins[f] = table.size();
+        } else {
+            bins[f] = std::lower_bound(table.begin(), table.end(), observation[f]) - table.begin();
+        }
+    }
+}
+
+int QuantizedForest::findLeaf_(int tree, const uint16_t* bins) const
+{
+    /** Walk one tree with an encoded observation, and return the position of the leaf value it reaches. */
+    uint32_t position = this->roots_[tree];
+    while (this->nodes_[position].feature!=QUANTIZED_FOREST_LEAF)
+    {
+        const QuantizedNode& node = this->nodes_[position];
+        position = ( bins[node.feature] <= node.bin ) ? position+1 : node.right;
+    }
+    return this->nodes_[position].right;
+}
+
+double QuantizedForest::aggregate_(const double* sums) const
+{
+    /** Mean value (regression) or majority vote (classification, breaking ties in favor of smallest label). */
+    if (this->regression_) {
+        return sums[0] / this->roots_.size();
+    }
+    int best = 0;
+    for (int c = 1; c < this->classes_.size(); c++)
+    {
+        if (sums[c]>sums[best]) { best = c; }
+    }
+    return this->classes_[best];
+}
+
+double QuantizedForest::predictEncoded(const uint16_t* bins) const
+{
+    /** Prediction of the forest for an observation encoded with encode (adding up leaves in tree order). */
+    assert (this->roots_.size()>0);
+    int width = this->regression_ ? 1 : this->classes_.size();
+    std::vector<double> sums(width, 0.0);
+    for (int t = 0; t < this->roots_.size(); t++)
+    {
+        int leaf = this->findLeaf_(t, bins);
+        if (this->regression_) {
+            sums[0] += this->leaf_values_[leaf];
+        } else {
+            sums[this->leaf_votes_[leaf]] += 1;
+        }
+    }
+    return this->aggregate_(sums.data());
+}
+
+double QuantizedForest::predict(const double* observation, size_t n) const
+{
+    /** Prediction of the forest for a single observation given as raw values (same as RandomForest::predict). */
+    std::vector<uint16_t> bins(this->num_features_);
+    this->encode(observation, n, bins.data());
+    return this->predictEncoded(bins.data());
+}
+
+DataVector QuantizedForest::predict(DataFrame* testdata) const
+{
+    /**
+     * Perform prediction on blocks of observations and collect a vector of predictions
+     * (same predictions as RandomForest::predict). Each block is encoded once, then walked by every tree.
+     */
+    assert (this->roots_.size()>0);
+    // Make sure dataframe has the correct number of features (or one extra column with labels).
+    assert ( (testdata->width()==this->num_features_) or (testdata->width()==this->num_features_+1) );
+    int num_rows = testdata->length();
+    int width = this->regression_ ? 1 : this->classes_.size();
+    std::vector<double> predictions(num_rows);
+    int num_blocks = (num_rows+this->block_size_-1)/this->block_size_;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int b = 0; b < num_blocks; b++)
+    {
+        int start = b*this->block_size_;
+        int n = std::min(start+this->block_size_, num_rows) - start;
+        std::vector<uint16_t> bins(n*this->num_features_);
+        for (int i = 0; i < n; i++)
+        {
+            this->encode(testdata->row(start+i)->data(), testdata->width(), bins.data()+i*this->num_features_);
+        }
+        // Votes (or sums) for this block, with trees as the outer loop:
+        std::vector<double> sums(n*width, 0.0);
+        for (int t = 0; t < this->roots_.size(); t++)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                int leaf = this->findLeaf_(t, bins.data()+i*this->num_features_);
+                if (this->regression_) {
+                    sums[i] += this->leaf_values_[leaf];
+                } else {
+                    sums[i*width+this->leaf_votes_[leaf]] += 1;
+                }
+            }
+        }
+        for (int i = 0; i < n; i++)
+        {
+            predictions[start+i] = this->aggregate_(sums.data()+i*width);
+        }
+    }
+    return DataVector(predictions, false);  // is_row=false.
+}
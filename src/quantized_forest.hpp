@@ -0,0 +1,77 @@
+#ifndef QUANTIZED_FOREST_HPP
+#define QUANTIZED_FOREST_HPP
+
+#include "random_forest.hpp"
+#include "decision_tree.hpp"
+#include "tree_node.hpp"
+#include "datasets.hpp"
+#include <cstdint>
+
+struct QuantizedNode
+{
+    /**
+     * A node of a QuantizedForest (stored by value in one array for all trees).
+     * The left child of a split is the next node, so only the right child is stored.
+     * */
+    uint16_t feature;  // Index of splitting column (or QUANTIZED_FOREST_LEAF for leaves).
+    uint16_t bin;  // Position of splitting threshold in the table of its feature (observations with bin <= this go left).
+    uint32_t right;  // Position of right child (or position of leaf value, for leaves).
+};
+
+class QuantizedForest
+{
+    /**
+     * A fitted RandomForest (or DecisionTree) with thresholds replaced by their position in a sorted table
+     * of the thresholds used on each feature. Observations are encoded once (each value becomes the number
+     * of thresholds of its feature below it), and trees then only compare small integers:
+     * value <= threshold exactly when bin of value <= bin of threshold, so predictions are identical.
+     * Missing values are encoded past the last threshold, so they go right as in the original trees.
+     * */
+
+private:
+
+    // Attributes:
+    std::vector<QuantizedNode> nodes_;  // Nodes of all trees (depth-first order).
+    std::vector<uint32_t> roots_;  // Position of the root of each tree.
+    std::vector<double> leaf_values_;  // Prediction at each leaf (mean value or majority class).
+    std::vector<int> leaf_votes_;  // Position of each leaf value in sorted class labels (classification only).
+    std::vector<std::vector<double>> thresholds_;  // Sorted unique splitting thresholds of each feature.
+    bool regression_;  // Use regression==false for a classification forest.
+    int num_features_;  // Number of features in dataset.
+    std::vector<double> classes_;  // Sorted class labels (classification only).
+    int block_size_;  // Number of observations encoded and predicted together by all trees.
+
+    // Utilities:
+    void collect_(TreeNode* node);  // Add thresholds of subtree rooted at given node to the tables.
+    void sortThresholds_();  // Sort tables and remove duplicates.
+    uint32_t compile_(TreeNode* node);  // Append subtree rooted at given node (returns its position).
+    int findLeaf_(int tree, const uint16_t* bins) const;  // Position of leaf value reached by an encoded observation.
+    double aggregate_(const double* sums) const;  // Mean value or majority vote from accumulated sums (or votes).
+
+public:
+
+    // Constructors:
+    QuantizedForest(const RandomForest& forest);
+    QuantizedForest(const DecisionTree& tree);
+
+    // Getters:
+    int getNumTrees() const;  // Number of trees.
+    int getNumNodes() const;  // Number of nodes in all trees.
+    int getNumFeatures() const;  // Number of features in dataset.
+    bool isRegressionTree() const;  // Type of forest (classification or regression).
+    std::vector<double> getClasses() const;  // Sorted class labels (classification only).
+    std::vector<double> getThresholds(int feature) const;  // Sorted thresholds of a feature (bin i is thresholds[i]).
+    size_t getModelBytes() const;  // Memory used by nodes, leaf values and threshold tables.
+
+    // Setters:
+    void setBlockSize(int block_size);  // Number of observations encoded and predicted together by all trees.
+
+    // Utilities:
+    void encode(const double* observation, size_t n, uint16_t* bins) const;  // Map raw feature values to bin ids.
+    double predictEncoded(const uint16_t* bins) const;  // Prediction of the forest for an encoded observation.
+    double predict(const double* observation, size_t n) const;  // Prediction of the forest for a single observation.
+    DataVector predict(DataFrame* testdata) const;  // Perform prediction on each observation (encoded in blocks).
+
+};
+
+#endif
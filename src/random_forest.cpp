@@ -4,11 +4,15 @@
 #include "datasets.hpp"
 #include "losses.hpp"
 #include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <unordered_set>
 
 // Constructors:
 RandomForest::RandomForest(
     DataFrame dataframe, int num_trees, bool regression, std::string loss, int mtry,
-    int max_height, int max_leaves, int min_obs, double max_prop, int seed
+    int max_height, int max_leaves, int min_obs, double max_prop, int seed,
+    std::string split_method, double max_samples, bool replace
 )
 {
     /**
@@ -23,6 +27,10 @@ RandomForest::RandomForest(
      *    min_obs    : Stopping condition: minimum number of observations in a leaf (or -1 for no stopping on this condition).
      *    max_prop   : Stopping condition: maximum proportion of majority class in a leaf (or -1 for no stopping on this condition).
      *    seed       : Non-negative seed (for repeatable results), or -1 (for non-deterministic sequence).
+     *    split_method : Split search used by each tree: "exact", "presorted" or "histogram" (see DecisionTree).
+     *    max_samples  : Rows drawn to train each tree: a fraction of the training data (if at most 1),
+     *                   an absolute number of rows (if larger than 1), or -1 for as many rows as the training data.
+     *    replace      : Draw rows with replacement (bootstrap) or without replacement (subsampling).
     */
     // Check inputs:
     assert ((dataframe.length()>0) and dataframe.width()>0);  // Need at least one row and column (plus class column).
@@ -34,6 +42,7 @@ RandomForest::RandomForest(
     assert ((max_prop==-1) or (max_prop<=1));  // Proportion cannot be larger than 1.
     assert ((max_prop==-1) or (!regression));  // Proportion is only defined for classification, not regression.
     assert ((mtry>=-1) and (mtry<dataframe.width()));  // num_features = dataframe.width()-1  (column of labels is not a feature).
+    assert ((max_samples==-1) or (max_samples>0));  // -1 indicates a sample as large as the training data.
     if (regression) {
         // Regression tree:
         if ( (loss=="mean_squared_error") ) {
@@ -61,6 +70,23 @@ RandomForest::RandomForest(
     this->min_obs_ = min_obs;
     this->max_prop_ = max_prop;
     this->meta_seed_ = seed;  // Metaseed for random seed generator.
+    this->split_method_ = split_method;
+    if (max_samples==-1) {
+        this->num_samples_ = dataframe.length();
+    } else if (max_samples<=1) {
+        // Fraction of training data (at least one row):
+        this->num_samples_ = std::max(1, int(std::round(max_samples*dataframe.length())));
+    } else {
+        // Absolute number of rows:
+        this->num_samples_ = int(std::round(max_samples));
+    }
+    if (!replace) {
+        // Cannot draw more rows than there are without replacement:
+        this->num_samples_ = std::min(this->num_samples_, dataframe.length());
+    }
+    this->replace_ = replace;
+    this->block_size_ = 256;
+    this->early_exit_ = false;
     // Initialize:
     this->fitted_ = false;
     this->seed_gen = SeedGenerator(this->meta_seed_);
@@ -68,6 +94,45 @@ RandomForest::RandomForest(
     this->fit_();
 };
 
+RandomForest::RandomForest(const RandomForest& forest) : RandomForest(forest, nullptr)
+{
+    /**
+     * Copy of a forest, with a copy of the nodes of each tree (so compacting either forest leaves the other one unchanged).
+     * Subtrees shared between trees by compact are copied once per use (compact the copy to share them again).
+     */
+}
+
+RandomForest::RandomForest(const RandomForest& forest, const std::vector<int>* trees) :
+    num_trees_(forest.num_trees_), dataframe_(forest.dataframe_), regression_(forest.regression_), loss_(forest.loss_),
+    mtry_(forest.mtry_), max_height_(forest.max_height_), max_leaves_(forest.max_leaves_), min_obs_(forest.min_obs_),
+    max_prop_(forest.max_prop_), num_features_(forest.num_features_), fitted_(forest.fitted_), meta_seed_(forest.meta_seed_),
+    seed_gen(forest.seed_gen), split_method_(forest.split_method_), num_samples_(forest.num_samples_), replace_(forest.replace_),
+    ranked_(forest.ranked_), binned_(forest.binned_), classes_(forest.classes_), block_size_(forest.block_size_),
+    tree_order_(forest.tree_order_), early_exit_(forest.early_exit_)
+{
+    /** Copy of a forest with a copy of the nodes of the given trees (in that order), or of all trees (with nullptr). */
+    if (trees==nullptr) {
+        for (const DecisionTree& tree : forest.trees_)
+        {
+            this->trees_.push_back(tree.clone());
+        }
+    } else {
+        for (int t : *trees)
+        {
+            this->trees_.push_back(forest.trees_[t].clone());
+        }
+    }
+}
+
+RandomForest& RandomForest::operator=(const RandomForest& forest)
+{
+    /** Replace this forest by a copy of given forest (with nodes of its own, as the copy constructor). */
+    if (this!=&forest) {
+        *this = RandomForest(forest);
+    }
+    return *this;
+}
+
 // Getters:
 int RandomForest::getNumTrees() const
 {
@@ -89,18 +154,38 @@ bool RandomForest::isFitted() const
 
 std::vector<DecisionTree> RandomForest::getTrees() const
 {
-    /** Get a vector of the fitted trees. */
+    /** Get a copy of the fitted trees, with nodes of their own (so they stay valid after compact). */
     assert (this->isFitted());
-    return this->trees_;
+    std::vector<DecisionTree> trees;
+    for (const DecisionTree& tree : this->trees_)
+    {
+        trees.push_back(tree.clone());
+    }
+    return trees;
 }
 
 DecisionTree RandomForest::getTree(int i) const
 {
-    /** Get one of the fitted trees. */
+    /** Get a copy of one of the fitted trees, with nodes of its own (so it stays valid after compact). */
     assert (i>=0);
     assert (i<this->trees_.size());
     assert (this->isFitted());
-    return this->trees_[i];
+    return this->trees_[i].clone();
+}
+
+std::vector<TreeNode*> RandomForest::getRoots() const
+{
+    /**
+     * Root node of each tree, without copying the trees (e.g. to compile them).
+     * Nodes belong to the forest: they must not be changed, nor used after the forest is compacted or destroyed.
+     */
+    assert (this->isFitted());
+    std::vector<TreeNode*> roots;
+    for (const DecisionTree& tree : this->trees_)
+    {
+        roots.push_back(tree.getRoot());
+    }
+    return roots;
 }
 
 DataFrame RandomForest::getDataFrame() const
@@ -109,65 +194,731 @@ DataFrame RandomForest::getDataFrame() const
     return this->dataframe_;
 }
 
+int RandomForest::getNumSamples() const
+{
+    /** Number of rows drawn to train each tree. */
+    return this->num_samples_;
+}
+
+std::vector<double> RandomForest::getClasses() const
+{
+    /** Sorted class labels of training data (classification only). */
+    return this->classes_;
+}
+
+std::vector<int> RandomForest::getTreeOrder() const
+{
+    /** Indices of the trees in the order used by predictWithBudget (best out-of-bag score first). */
+    return this->tree_order_;
+}
+
+bool RandomForest::isEarlyExit() const
+{
+    /** Indicates whether classification stops evaluating trees once the majority class is decided. */
+    return this->early_exit_;
+}
+
+int RandomForest::getNumNodes() const
+{
+    /** Number of nodes in all trees, counting once the nodes shared by several trees (see compact). */
+    std::unordered_set<const TreeNode*> nodes;
+    std::vector<const TreeNode*> stack;
+    for (const DecisionTree& tree : this->trees_)
+    {
+        stack.push_back(tree.getRoot());
+        while (stack.size()>0)
+        {
+            const TreeNode* node = stack.back();
+            stack.pop_back();
+            // Subtrees of a node seen before were already counted:
+            if ( nodes.insert(node).second and (!node->isLeaf()) ) {
+                stack.push_back(node->getLeft());
+                stack.push_back(node->getRight());
+            }
+        }
+    }
+    return nodes.size();
+}
+
 
 // Setters:
 
+void RandomForest::setBlockSize(int block_size)
+{
+    /** Number of observations predicted together by all trees (small enough for their votes to stay in cache). */
+    assert (block_size>0);
+    this->block_size_ = block_size;
+}
+
+void RandomForest::setEarlyExit(bool early_exit)
+{
+    /**
+     * Classification only: stop evaluating the trees for an observation as soon as its majority class is decided
+     * (predictions are identical to full evaluation, but observations are then predicted one at a time).
+     */
+    this->early_exit_ = early_exit;
+}
+
 // Utilities:
 
 void RandomForest::fit_()
 {
     /** Fit RandomForest with given parameters. */
     this->trees_ = {};
+    if (this->split_method_=="presorted") {
+        // Rank-encode the training data once; every tree reads the same (read-only) ranks:
+        this->ranked_ = std::make_shared<const RankedDataFrame>(this->dataframe_, this->num_features_);
+    } else if (this->split_method_=="histogram") {
+        // Bin the training data once; every tree reads the same (read-only) bins:
+        this->binned_ = std::make_shared<const BinnedDataFrame>(this->dataframe_, this->num_features_);
+    }
+    if (!this->regression_) {
+        // Sorted unique class labels, used to index the votes of each observation:
+        DataVector labels = this->dataframe_.col(-1);
+        this->classes_ = labels.vector();
+        std::sort(this->classes_.begin(), this->classes_.end());
+        this->classes_.erase(std::unique(this->classes_.begin(), this->classes_.end()), this->classes_.end());
+    }
     for (int i = 0; i < this->num_trees_; i++)
     {
         int data_seed = this->seed_gen.new_seed();
         int tree_seed = this->seed_gen.new_seed();
-        DataFrame bootstrap = this->dataframe_.sample(-1, data_seed, true);
+        // Bootstrap sample (or subsample), represented by the number of times each training row is drawn:
+        std::vector<int> bootstrap_counts = this->dataframe_.sample_counts(this->num_samples_, data_seed, this->replace_);
         DecisionTree tree = DecisionTree(
-            bootstrap, this->regression_, this->loss_, this->mtry_,
-            this->max_height_, this->max_leaves_, this->min_obs_, this->max_prop_, tree_seed
+            this->dataframe_, this->regression_, this->loss_, this->mtry_,
+            this->max_height_, this->max_leaves_, this->min_obs_, this->max_prop_, tree_seed,
+            this->split_method_, bootstrap_counts, this->ranked_, this->binned_
         );
         this->trees_.push_back(tree);
     }
+    this->orderTrees_();
     this->fitted_ = true;
 }
 
+void RandomForest::orderTrees_()
+{
+    /**
+     * Order trees by decreasing out-of-bag score (accuracy for classification, negative mean squared error for regression),
+     * so that a prefix of the order is as accurate as possible (see predictWithBudget).
+     * Trees without out-of-bag rows score zero; ties keep the fitting order.
+     */
+    int num_trees = this->trees_.size();
+    int num_rows = this->dataframe_.length();
+    int width = this->dataframe_.width();
+    std::vector<double> scores(num_trees, 0.0);
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int i = 0; i < num_trees; i++)
+    {
+        std::vector<int> counts = this->trees_[i].getSampleWeights();
+        double score = 0;
+        int num_oob = 0;
+        for (int r = 0; r < num_rows; r++)
+        {
+            if (counts[r]>0) { continue; }
+            const double* values = this->dataframe_.row(r)->data();
+            double prediction = this->trees_[i].predict_one(values, width);
+            double label = values[width-1];
+            if (this->regression_) {
+                score -= (prediction-label)*(prediction-label);
+            } else {
+                score += (prediction==label);
+            }
+            num_oob++;
+        }
+        scores[i] = (num_oob>0) ? score/num_oob : 0;
+    }
+    this->tree_order_ = std::vector<int>(num_trees);
+    for (int i = 0; i < num_trees; i++)
+    {
+        this->tree_order_[i] = i;
+    }
+    std::stable_sort(this->tree_order_.begin(), this->tree_order_.end(), [&scores](int a, int b) { return scores[a]>scores[b]; });
+}
+
+template <typename T>
+int RandomForest::vote_(const T* features, size_t col_stride, double* votes, int& best) const
+{
+    /**
+     * Collect the votes of the trees (in order) for a single observation into `votes` (one count per class)
+     * and set `best` to the index of the majority class (breaking ties in favor of smallest label).
+     * In early-exit mode, stops as soon as the remaining trees can no longer change the majority class
+     * (so `votes` only counts the trees evaluated). Returns the number of trees evaluated.
+     */
+    int width = this->classes_.size();
+    int num_trees = this->trees_.size();
+    std::fill(votes, votes+width, 0.0);
+    best = 0;
+    for (int i = 0; i < num_trees; i++)
+    {
+        double prediction = this->trees_[i].predictStrided(features, col_stride);
+        int c = std::lower_bound(this->classes_.begin(), this->classes_.end(), prediction) - this->classes_.begin();
+        votes[c] += 1;
+        // Only the class that just received a vote can take over the lead:
+        if ( (votes[c]>votes[best]) or ( (votes[c]==votes[best]) and (c<best) ) ) { best = c; }
+        if (!this->early_exit_) { continue; }
+        // Majority is decided if no other class would win even if it received all remaining votes:
+        int remaining = num_trees-i-1;
+        if (votes[best]<remaining) { continue; }
+        bool decided = true;
+        for (int k = 0; (k < width) and decided; k++)
+        {
+            if (k==best) { continue; }
+            double overturn = votes[k]+remaining;
+            decided = (votes[best]>overturn) or ( (votes[best]==overturn) and (best<k) );
+        }
+        if (decided) { return i+1; }
+    }
+    return num_trees;
+}
+
+void RandomForest::predict_one(const double* features, size_t n, double* output, double* votes) const
+{
+    /**
+     * Perform prediction on a single observation given as raw values (features[0],...,features[n-1]), writing
+     * the prediction to output[0], without constructing a DataFrame or allocating anything.
+     * For classification, `votes` must have room for one count per class (see getClasses), and receives the votes;
+     * it is not used for regression.
+     */
+    assert (this->isFitted());
+    // Make sure observation has the correct number of features (or one extra value with its label).
+    assert ( (n==this->num_features_) or (n==this->num_features_+1) );
+    if (this->isRegressionTree()) {
+        // Regression tree: Predict mean of ensemble predictions (added in tree order):
+        double sum = 0;
+        for (int i = 0; i < this->trees_.size(); i++)
+        {
+            sum += this->trees_[i].predict_one(features, n);
+        }
+        output[0] = sum / this->trees_.size();
+    } else {
+        // Classification tree: Predict majority class of ensemble predictions (breaking ties in favor of smallest label):
+        int best;
+        this->vote_(features, 1, votes, best);
+        output[0] = this->classes_[best];
+    }
+}
+
+void RandomForest::predict_one(const double* features, size_t n, double* output) const
+{
+    /** Perform prediction on a single observation given as raw values, writing it to output[0]. */
+    // Votes go to a buffer kept by each thread (only allocated the first time it needs to grow):
+    thread_local std::vector<double> votes;
+    if (votes.size()<this->classes_.size()) {
+        votes.resize(this->classes_.size());
+    }
+    this->predict_one(features, n, output, votes.data());
+}
+
+double RandomForest::predict_one(const double* features, size_t n) const
+{
+    /** Perform prediction on a single observation given as raw values. */
+    double prediction;
+    this->predict_one(features, n, &prediction);
+    return prediction;
+}
+
+void RandomForest::predictBlock_(DataFrame* testdata, int start, int end, std::vector<double>& sums) const
+{
+    /**
+     * Accumulate predictions of all trees for observations start,...,end-1 into `sums`
+     * (regression: one sum per observation; classification: one vote count per observation and class).
+     * Trees are the outer loop, so each tree is walked for the whole block while it is in cache.
+     */
+    int width = this->regression_ ? 1 : this->classes_.size();
+    for (int i = 0; i < this->trees_.size(); i++)
+    {
+        for (int j = start; j < end; j++)
+        {
+            double prediction = this->trees_[i].predict(testdata->row(j));
+            if (this->regression_) {
+                sums[j] += prediction;
+            } else {
+                int c = std::lower_bound(this->classes_.begin(), this->classes_.end(), prediction) - this->classes_.begin();
+                sums[j*width+c] += 1;
+            }
+        }
+    }
+}
+
 DataVector RandomForest::predict(DataFrame* testdata) const
 {
-    /** Perform prediction sequentially on each observation and collect a vector of predictions. */
-    DataVector predictions = DataVector(false);  // is_row=false.
+    /**
+     * Perform prediction on blocks of observations and collect a vector of predictions.
+     * Votes (or sums) of all trees are accumulated in a dense array, in parallel across blocks.
+     */
     // Make sure tree has been fitted before prediction:
     assert (this->isFitted());
     // Make sure dataframe has the correct number of features (or one extra column with labels).
     assert ( (testdata->width()==this->num_features_) or (testdata->width()==this->num_features_+1) );
-    // Create DataFrame to store predictions (one row per observation, one column per decision tree):
-    DataFrame ensemble_predicions = DataFrame();  // Will delete rows from heap once predictions have been aggregated.
-    for (int i = 0; i < this->trees_.size(); i++)
+    int num_rows = testdata->length();
+    int width = this->regression_ ? 1 : this->classes_.size();
+    if (this->early_exit_ and !this->regression_) {
+        // Early exit: Evaluate the trees one observation at a time, stopping once its majority is decided:
+        std::vector<double> predictions(num_rows);
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic)
+        #endif
+        for (int j = 0; j < num_rows; j++)
+        {
+            this->predict_one(testdata->row(j)->data(), testdata->width(), &predictions[j]);
+        }
+        return DataVector(predictions, false);  // is_row=false.
+    }
+    std::vector<double> sums(num_rows*width, 0.0);
+    int num_blocks = (num_rows+this->block_size_-1)/this->block_size_;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int b = 0; b < num_blocks; b++)
     {
-        DataVector tree_predictions = this->trees_[i].predict(testdata);
-        ensemble_predicions.addCol(tree_predictions.vector());
+        int start = b*this->block_size_;
+        int end = std::min(start+this->block_size_, num_rows);
+        this->predictBlock_(testdata, start, end, sums);
     }
-    // Aggregate ensemble predictiosn:
-    DataVector *observation_predictions;
-    double prediction;
-    for (int j = 0; j < ensemble_predicions.length(); j++)
+    // Aggregate ensemble predictions:
+    std::vector<double> predictions(num_rows);
+    for (int j = 0; j < num_rows; j++)
     {
-        observation_predictions = ensemble_predicions.row(j);
         if (this->isRegressionTree()) {
             // Regression tree: Predict mean of ensemble predictions:
-            prediction = observation_predictions->mean();
+            predictions[j] = sums[j] / this->trees_.size();
         } else {
-            // Classification tree: Predict majority class of ensemble predictions:
-            prediction = LabelCounter(observation_predictions).get_most_frequent();
+            // Classification tree: Predict majority class of ensemble predictions (breaking ties in favor of smallest label):
+            int best = 0;
+            for (int c = 1; c < width; c++)
+            {
+                if (sums[j*width+c]>sums[j*width+best]) { best = c; }
+            }
+            predictions[j] = this->classes_[best];
         }
-        // Add prediction made by ensemble for this observation:
-        predictions.addValue(prediction);
     }
-    // Remove rows from heap:
-    for (int k = 0; k < ensemble_predicions.length(); k++)
+    // Return result:
+    return DataVector(predictions, false);  // is_row=false.
+}
+
+template <typename T>
+void RandomForest::predictStrided_(const T* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const
+{
+    /** Perform prediction on each row of an external buffer (in blocks, as predict does for a DataFrame). */
+    assert (this->isFitted());
+    // Make sure buffer has the correct number of features (or one extra column with labels).
+    assert ( (num_features==this->num_features_) or (num_features==this->num_features_+1) );
+    int width = this->regression_ ? 1 : this->classes_.size();
+    if (this->early_exit_ and !this->regression_) {
+        // Early exit: Evaluate the trees one row at a time, stopping once its majority is decided:
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic)
+        #endif
+        for (long r = 0; r < long(num_rows); r++)
+        {
+            thread_local std::vector<double> votes;
+            if (votes.size()<this->classes_.size()) {
+                votes.resize(this->classes_.size());
+            }
+            int best;
+            this->vote_(data+r*row_stride, col_stride, votes.data(), best);
+            output[r] = this->classes_[best];
+        }
+        return;
+    }
+    int num_blocks = (num_rows+this->block_size_-1)/this->block_size_;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int b = 0; b < num_blocks; b++)
     {
-        delete ensemble_predicions.row(k);  // Delete rows that were added to heap by this function.
+        size_t start = size_t(b)*this->block_size_;
+        size_t end = std::min(start+this->block_size_, num_rows);
+        // Votes (or sums) for this block, with trees as the outer loop:
+        std::vector<double> sums((end-start)*width, 0.0);
+        for (int i = 0; i < this->trees_.size(); i++)
+        {
+            for (size_t r = start; r < end; r++)
+            {
+                double prediction = this->trees_[i].predictStrided(data+r*row_stride, col_stride);
+                if (this->regression_) {
+                    sums[r-start] += prediction;
+                } else {
+                    int c = std::lower_bound(this->classes_.begin(), this->classes_.end(), prediction) - this->classes_.begin();
+                    sums[(r-start)*width+c] += 1;
+                }
+            }
+        }
+        for (size_t r = start; r < end; r++)
+        {
+            if (this->regression_) {
+                output[r] = sums[r-start] / this->trees_.size();
+            } else {
+                // Majority vote, breaking ties in favor of smallest label:
+                int best = 0;
+                for (int c = 1; c < width; c++)
+                {
+                    if (sums[(r-start)*width+c]>sums[(r-start)*width+best]) { best = c; }
+                }
+                output[r] = this->classes_[best];
+            }
+        }
     }
-    // Return result:
-    return predictions;
+}
+
+void RandomForest::predict(const double* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const
+{
+    /**
+     * Perform prediction on each row of an external buffer, without copying it:
+     * value of feature f in row r is data[r*row_stride+f*col_stride]
+     * (row-major: row_stride=num_features and col_stride=1; column-major: row_stride=1 and col_stride=num_rows).
+     * Predictions are written to output[0],...,output[num_rows-1].
+     */
+    this->predictStrided_(data, num_rows, num_features, row_stride, col_stride, output);
+}
+
+void RandomForest::predict(const float* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const
+{
+    /** Perform prediction on each row of an external buffer of floats (see above), without copying it. */
+    this->predictStrided_(data, num_rows, num_features, row_stride, col_stride, output);
+}
+
+template <typename F>
+void RandomForest::predictProba_(F row, size_t num_rows, size_t col_stride, double* output) const
+{
+    /**
+     * Mean over trees of the class distribution of the leaf reached by each row (row(r) points to its first value,
+     * and values are col_stride apart). Row r of the output has the probabilities of getClasses() at output[r*num_classes+c].
+     */
+    assert (this->isFitted());
+    assert (!this->isRegressionTree());  // Probabilities are only defined for classification.
+    size_t num_classes = this->classes_.size();
+    std::fill(output, output+num_rows*num_classes, 0.0);
+    int num_blocks = (num_rows+this->block_size_-1)/this->block_size_;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int b = 0; b < num_blocks; b++)
+    {
+        size_t start = size_t(b)*this->block_size_;
+        size_t end = std::min(start+this->block_size_, num_rows);
+        // Add up leaf distributions with trees as the outer loop (every tree has the same sorted classes):
+        for (int i = 0; i < this->trees_.size(); i++)
+        {
+            for (size_t r = start; r < end; r++)
+            {
+                const double* distribution = this->trees_[i].findLeaf(row(r), col_stride)->getDistribution().data();
+                double* probabilities = output+r*num_classes;
+                for (size_t c = 0; c < num_classes; c++)
+                {
+                    probabilities[c] += distribution[c];
+                }
+            }
+        }
+        for (size_t k = start*num_classes; k < end*num_classes; k++)
+        {
+            output[k] /= this->trees_.size();
+        }
+    }
+}
+
+void RandomForest::predict_proba(const double* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const
+{
+    /** Probability of each class for each row of an external buffer (see predict), written to output (rows x classes). */
+    assert ( (num_features==this->num_features_) or (num_features==this->num_features_+1) );
+    this->predictProba_([data, row_stride](size_t r) { return data+r*row_stride; }, num_rows, col_stride, output);
+}
+
+DataFrame RandomForest::predict_proba(DataFrame* testdata) const
+{
+    /** Probability of each class for each observation (one row per observation, one column per class in getClasses()). */
+    assert ( (testdata->width()==this->num_features_) or (testdata->width()==this->num_features_+1) );
+    int num_rows = testdata->length();
+    int num_classes = this->classes_.size();
+    std::vector<double> probabilities(num_rows*num_classes);
+    this->predictProba_([testdata](size_t r) { return testdata->row(r)->data(); }, num_rows, 1, probabilities.data());
+    std::vector<std::vector<double>> matrix;
+    for (int j = 0; j < num_rows; j++)
+    {
+        matrix.push_back(std::vector<double>(probabilities.begin()+j*num_classes, probabilities.begin()+(j+1)*num_classes));
+    }
+    return DataFrame(matrix);
+}
+
+int RandomForest::predictWithBudget(const double* features, size_t n, double* output, int max_trees, double max_seconds) const
+{
+    /**
+     * Perform prediction on a single observation given as raw values (see predict_one) with a budget:
+     * trees are evaluated in the order of getTreeOrder() until `max_trees` trees (or -1 for all)
+     * have been evaluated or `max_seconds` (or -1 for no limit) have elapsed,
+     * and the prediction of those trees is written to output[0]. At least one tree is always evaluated.
+     * Returns the number of trees evaluated.
+     */
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    assert (this->isFitted());
+    assert ( (n==this->num_features_) or (n==this->num_features_+1) );
+    assert (max_trees!=0);
+    int num_trees = this->trees_.size();
+    if ( (max_trees<0) or (max_trees>num_trees) ) {
+        max_trees = num_trees;
+    }
+    int width = this->regression_ ? 1 : this->classes_.size();
+    thread_local std::vector<double> votes;
+    if (votes.size()<width) {
+        votes.resize(width);
+    }
+    std::fill(votes.begin(), votes.begin()+width, 0.0);
+    int used = 0;
+    while (used<max_trees)
+    {
+        if ( (used>0) and (max_seconds>=0) and (std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()>=max_seconds) ) {
+            break;
+        }
+        double prediction = this->trees_[this->tree_order_[used]].predict_one(features, n);
+        if (this->regression_) {
+            votes[0] += prediction;
+        } else {
+            votes[std::lower_bound(this->classes_.begin(), this->classes_.end(), prediction) - this->classes_.begin()] += 1;
+        }
+        used++;
+    }
+    if (this->regression_) {
+        // Regression tree: Mean of the predictions of the trees evaluated:
+        output[0] = votes[0] / used;
+    } else {
+        // Classification tree: Majority class of the trees evaluated (breaking ties in favor of smallest label):
+        int best = 0;
+        for (int c = 1; c < width; c++)
+        {
+            if (votes[c]>votes[best]) { best = c; }
+        }
+        output[0] = this->classes_[best];
+    }
+    return used;
+}
+
+DataVector RandomForest::predictWithBudget(DataFrame* testdata, int max_trees, double max_seconds, int* trees_used) const
+{
+    /**
+     * Perform prediction on all observations with a budget for the whole call (see above):
+     * each tree (in the order of getTreeOrder()) is evaluated on all observations before checking the budget,
+     * so every observation is predicted by the same trees. Their number is written to trees_used (if given).
+     */
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    assert (this->isFitted());
+    assert ( (testdata->width()==this->num_features_) or (testdata->width()==this->num_features_+1) );
+    assert (max_trees!=0);
+    int num_trees = this->trees_.size();
+    if ( (max_trees<0) or (max_trees>num_trees) ) {
+        max_trees = num_trees;
+    }
+    int num_rows = testdata->length();
+    int width = this->regression_ ? 1 : this->classes_.size();
+    std::vector<double> sums(num_rows*width, 0.0);
+    int used = 0;
+    while (used<max_trees)
+    {
+        if ( (used>0) and (max_seconds>=0) and (std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()>=max_seconds) ) {
+            break;
+        }
+        const DecisionTree& tree = this->trees_[this->tree_order_[used]];
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(static)
+        #endif
+        for (int j = 0; j < num_rows; j++)
+        {
+            double prediction = tree.predict(testdata->row(j));
+            if (this->regression_) {
+                sums[j] += prediction;
+            } else {
+                sums[j*width+(std::lower_bound(this->classes_.begin(), this->classes_.end(), prediction) - this->classes_.begin())] += 1;
+            }
+        }
+        used++;
+    }
+    std::vector<double> predictions(num_rows);
+    for (int j = 0; j < num_rows; j++)
+    {
+        if (this->regression_) {
+            predictions[j] = sums[j] / used;
+        } else {
+            int best = 0;
+            for (int c = 1; c < width; c++)
+            {
+                if (sums[j*width+c]>sums[j*width+best]) { best = c; }
+            }
+            predictions[j] = this->classes_[best];
+        }
+    }
+    if (trees_used!=nullptr) {
+        *trees_used = used;
+    }
+    return DataVector(predictions, false);  // is_row=false.
+}
+
+CompactionStats RandomForest::compact(bool merge_leaves, bool share_subtrees)
+{
+    /**
+     * Make the fitted forest smaller without changing its predictions, and report the size reduction:
+     *    merge_leaves   : Turn splits whose children are leaves with the same prediction into leaves
+     *                     (the class distribution of a merged leaf, used by predict_proba, becomes that of its training rows).
+     *    share_subtrees : Keep a single copy of identical subtrees (same splits and leaves, within a tree or across trees),
+     *                     in a pool of nodes shared by all trees (class distributions do not change).
+     * Fewer nodes take less memory (and cache) during prediction, and make smaller compiled or generated models.
+     * Removed nodes are deleted (copies of the forest and trees from getTrees or getTree have nodes of their own, and are not affected).
+     */
+    assert (this->fitted_);
+    CompactionStats stats;
+    stats.nodes_before = this->getNumNodes();
+    stats.merged_nodes = 0;
+    stats.shared_nodes = 0;
+    if (merge_leaves) {
+        for (DecisionTree& tree : this->trees_)
+        {
+            stats.merged_nodes += tree.mergeLeaves(&this->pool_);
+        }
+    }
+    if (share_subtrees) {
+        for (DecisionTree& tree : this->trees_)
+        {
+            stats.shared_nodes += tree.shareSubtrees(this->pool_);
+        }
+    }
+    stats.nodes_after = this->getNumNodes();
+    return stats;
+}
+
+std::vector<int> RandomForest::selectTrees(DataFrame* validation, std::vector<double>* scores) const
+{
+    /**
+     * Order all trees greedily on validation data (with labels in the last column): starting from an empty forest,
+     * repeatedly add the tree that gives the best score to the forest of the trees chosen so far
+     * (accuracy for classification, negative mean squared error for regression; ties go to the first tree).
+     * Returns the indices of the trees in the order chosen, and optionally the score of each prefix of that order
+     * (scores[k] is the score of the forest of the first k+1 trees, as predicted by a forest of these trees in this order).
+     */
+    assert (this->fitted_);
+    assert (validation->width()==this->num_features_+1);  // Features and labels.
+    int num_trees = this->trees_.size();
+    int num_rows = validation->length();
+    int width = validation->width();
+    assert (num_rows>0);
+    // Prediction of each tree for each row (as a class index for classification), and labels:
+    std::vector<double> predictions(size_t(num_trees)*num_rows);
+    std::vector<double> labels(num_rows);
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int t = 0; t < num_trees; t++)
+    {
+        for (int r = 0; r < num_rows; r++)
+        {
+            double prediction = this->trees_[t].predict_one(validation->row(r)->data(), width);
+            if (!this->regression_) {
+                prediction = std::lower_bound(this->classes_.begin(), this->classes_.end(), prediction) - this->classes_.begin();
+            }
+            predictions[size_t(t)*num_rows+r] = prediction;
+        }
+    }
+    for (int r = 0; r < num_rows; r++)
+    {
+        double label = validation->value(r, width-1);
+        if (!this->regression_) {
+            // Class index of label (or -1 for a label not seen in training, which is never predicted):
+            auto found = std::lower_bound(this->classes_.begin(), this->classes_.end(), label);
+            label = ( (found!=this->classes_.end()) and (*found==label) ) ? found-this->classes_.begin() : -1;
+        }
+        labels[r] = label;
+    }
+    // State of the forest of chosen trees: sums (regression) or votes and majority class (classification) of each row:
+    int num_classes = this->classes_.size();
+    std::vector<double> sums(num_rows, 0.0);
+    std::vector<double> votes(this->regression_ ? 0 : size_t(num_rows)*num_classes, 0.0);
+    std::vector<int> best(num_rows, -1);
+    std::vector<bool> chosen(num_trees, false);
+    std::vector<int> order;
+    std::vector<double> prefix_scores;
+    for (int k = 0; k < num_trees; k++)
+    {
+        // Score of the forest with each remaining tree added (only the class receiving a vote can take the lead):
+        std::vector<double> candidate_scores(num_trees, 0.0);
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic)
+        #endif
+        for (int t = 0; t < num_trees; t++)
+        {
+            if (chosen[t]) { continue; }
+            const double* tree_predictions = predictions.data()+size_t(t)*num_rows;
+            double score = 0;
+            for (int r = 0; r < num_rows; r++)
+            {
+                if (this->regression_) {
+                    double error = (sums[r]+tree_predictions[r])/(k+1) - labels[r];
+                    score -= error*error;
+                } else {
+                    int c = tree_predictions[r];
+                    int b = best[r];
+                    const double* row_votes = votes.data()+size_t(r)*num_classes;
+                    bool lead = (b<0) or (row_votes[c]+1>row_votes[b]) or ( (row_votes[c]+1==row_votes[b]) and (c<b) );
+                    score += ( (lead ? c : b) == labels[r] );
+                }
+            }
+            candidate_scores[t] = score/num_rows;
+        }
+        int next = -1;
+        for (int t = 0; t < num_trees; t++)
+        {
+            if ( (!chosen[t]) and ( (next<0) or (candidate_scores[t]>candidate_scores[next]) ) ) { next = t; }
+        }
+        // Add chosen tree to the forest:
+        chosen[next] = true;
+        order.push_back(next);
+        prefix_scores.push_back(candidate_scores[next]);
+        const double* tree_predictions = predictions.data()+size_t(next)*num_rows;
+        for (int r = 0; r < num_rows; r++)
+        {
+            if (this->regression_) {
+                sums[r] += tree_predictions[r];
+            } else {
+                int c = tree_predictions[r];
+                double* row_votes = votes.data()+size_t(r)*num_classes;
+                row_votes[c] += 1;
+                if ( (best[r]<0) or (row_votes[c]>row_votes[best[r]]) or ( (row_votes[c]==row_votes[best[r]]) and (c<best[r]) ) ) {
+                    best[r] = c;
+                }
+            }
+        }
+    }
+    if (scores!=nullptr) {
+        *scores = prefix_scores;
+    }
+    return order;
+}
+
+RandomForest RandomForest::prune(DataFrame* validation, int num_trees) const
+{
+    /**
+     * Smaller forest made of the first trees in the greedy order of selectTrees on validation data (in that order):
+     * the first num_trees trees, or (with num_trees=-1) the fewest trees that reach the best validation score.
+     * The pruned forest has a copy of the nodes of each kept tree (so compacting either forest leaves the other one unchanged),
+     * and keeps its out-of-bag order for predictWithBudget.
+     */
+    assert ( (num_trees==-1) or ( (num_trees>0) and (num_trees<=this->trees_.size()) ) );
+    std::vector<double> scores;
+    std::vector<int> order = this->selectTrees(validation, &scores);
+    if (num_trees==-1) {
+        num_trees = std::max_element(scores.begin(), scores.end()) - scores.begin() + 1;  // First maximum.
+    }
+    order.resize(num_trees);
+    RandomForest pruned(*this, &order);
+    std::vector<int> positions(this->trees_.size(), -1);  // Position of each kept tree in the pruned forest.
+    for (int i = 0; i < num_trees; i++)
+    {
+        positions[order[i]] = i;
+    }
+    pruned.num_trees_ = num_trees;
+    pruned.tree_order_ = {};
+    for (int t : this->tree_order_)
+    {
+        if (positions[t]>=0) { pruned.tree_order_.push_back(positions[t]); }
+    }
+    return pruned;
 }
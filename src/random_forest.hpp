@@ -6,6 +6,15 @@
 #include "datasets.hpp"
 #include "losses.hpp"
 
+struct CompactionStats
+{
+    /** Size of a RandomForest before and after RandomForest::compact (nodes shared by several trees are counted once). */
+    int nodes_before;  // Number of nodes before compaction.
+    int merged_nodes;  // Number of nodes removed by merging sibling leaves.
+    int shared_nodes;  // Number of nodes replaced by identical ones of the shared pool.
+    int nodes_after;  // Number of nodes after compaction.
+};
+
 class RandomForest
 {
 private:
@@ -25,9 +34,27 @@ private:
     bool fitted_;  // State variable: Flag indicated whether or not the random forest has been trained.
     int meta_seed_;  // Metaseed for random seed generator.
     SeedGenerator seed_gen;  // Random seed generator.
+    std::string split_method_;  // String indicating split search method used by each tree.
+    int num_samples_;  // Hyperparameter: Number of rows drawn to train each tree.
+    bool replace_;  // Hyperparameter: Draw rows with replacement (bootstrap) or without (subsampling).
+    std::shared_ptr<const RankedDataFrame> ranked_;  // Rank-encoded training data shared by all trees (presorted split search).
+    std::shared_ptr<const BinnedDataFrame> binned_;  // Binned training data shared by all trees (histogram split search).
+    std::vector<double> classes_;  // Sorted class labels of training data (classification only).
+    int block_size_;  // Number of observations predicted together by all trees.
+    std::vector<int> tree_order_;  // Indices of the trees by decreasing out-of-bag score (order used for prediction with a budget).
+    bool early_exit_;  // Stop evaluating trees once the majority class of an observation is decided (classification only).
+    SubtreePool pool_;  // Subtrees shared between trees by compact (kept, so that later compactions do not delete them).
+
+    // Constructors:
+    RandomForest(const RandomForest& forest, const std::vector<int>* trees);  // Copy of a forest with its own copy of the given trees (or all trees).
 
     // Utilities:
     void fit_();  // Perform fitting (using fit_ helper).
+    void orderTrees_();  // Order trees by decreasing out-of-bag score.
+    void predictBlock_(DataFrame* testdata, int start, int end, std::vector<double>& sums) const;  // Accumulate votes (or sums) of all trees for a block of observations.
+    template <typename T> int vote_(const T* features, size_t col_stride, double* votes, int& best) const;  // Votes of the trees (in order) for one observation.
+    template <typename F> void predictProba_(F row, size_t num_rows, size_t col_stride, double* output) const;  // Mean leaf class distributions of given rows.
+    template <typename T> void predictStrided_(const T* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const;  // Predict rows of an external buffer.
 
 public:
 
@@ -35,21 +62,46 @@ public:
     RandomForest(
         DataFrame dataframe, int num_trees, bool regression=false,
         std::string loss="gini_impurity", int mtry=-1, int max_height=-1,
-        int max_leaves=-1, int min_obs=-1, double max_prop=-1, int seed=-1
+        int max_leaves=-1, int min_obs=-1, double max_prop=-1, int seed=-1,
+        std::string split_method="exact", double max_samples=-1, bool replace=true
     );
+    RandomForest(const RandomForest& forest);  // Copy with nodes of its own (unaffected by compacting either forest).
+    RandomForest(RandomForest&& forest) = default;
+    RandomForest& operator=(const RandomForest& forest);
+    RandomForest& operator=(RandomForest&& forest) = default;
 
     // Getters:
     int getNumTrees() const;  // Number of trees in RandomForest.
     bool isRegressionTree() const;  // Type of tree (classification or regression).
     bool isFitted() const;  // Indicates whether the tree has been fitted on training data.
-    std::vector<DecisionTree> getTrees() const;  // Get a vector of the fitted trees.
-    DecisionTree getTree(int i) const;  // Get one of the fitted trees.
+    std::vector<DecisionTree> getTrees() const;  // Get a copy of the fitted trees (with nodes of their own).
+    DecisionTree getTree(int i) const;  // Get a copy of one of the fitted trees (with nodes of its own).
+    std::vector<TreeNode*> getRoots() const;  // Root node of each tree (owned by the forest, and changed by compact).
     DataFrame getDataFrame() const;  // Training data.
+    int getNumSamples() const;  // Number of rows drawn to train each tree.
+    std::vector<double> getClasses() const;  // Sorted class labels of training data (classification only).
+    std::vector<int> getTreeOrder() const;  // Indices of the trees by decreasing out-of-bag score.
+    bool isEarlyExit() const;  // Indicates whether classification stops evaluating trees once the majority is decided.
+    int getNumNodes() const;  // Number of nodes in all trees (nodes shared by several trees are counted once).
 
     // Setters:
+    void setBlockSize(int block_size);  // Number of observations predicted together by all trees.
+    void setEarlyExit(bool early_exit);  // Stop evaluating trees once the majority class is decided (classification only).
 
     // Utilities:
     DataVector predict(DataFrame* testdata) const;  // Perform prediction sequentially on each observation.
+    double predict_one(const double* features, size_t n) const;  // Perform prediction on a single observation given as raw values (no allocation).
+    void predict_one(const double* features, size_t n, double* output) const;  // Same, writing the prediction to a caller-provided buffer.
+    void predict_one(const double* features, size_t n, double* output, double* votes) const;  // Same, also writing votes of each class (classification).
+    void predict(const double* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const;  // Predict rows of an external (strided) buffer.
+    void predict(const float* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const;  // Predict rows of an external (strided) buffer.
+    int predictWithBudget(const double* features, size_t n, double* output, int max_trees, double max_seconds=-1) const;  // Predict one observation from the best trees within a budget (returns number of trees used).
+    DataVector predictWithBudget(DataFrame* testdata, int max_trees, double max_seconds=-1, int* trees_used=nullptr) const;  // Same, for all observations (budget for the whole call).
+    DataFrame predict_proba(DataFrame* testdata) const;  // Probability of each class for each observation (one column per class).
+    void predict_proba(const double* data, size_t num_rows, size_t num_features, size_t row_stride, size_t col_stride, double* output) const;  // Same, for an external buffer (output: rows x classes).
+    CompactionStats compact(bool merge_leaves=true, bool share_subtrees=true);  // Merge sibling leaves and share identical subtrees between trees.
+    std::vector<int> selectTrees(DataFrame* validation, std::vector<double>* scores=nullptr) const;  // Order trees greedily by the validation score of the forest they form.
+    RandomForest prune(DataFrame* validation, int num_trees=-1) const;  // Smaller forest made of the first trees in greedy order.
 
 };
 
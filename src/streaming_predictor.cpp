@@ -0,0 +1,233 @@
+#include "streaming_predictor.hpp"
+#include "compiled_forest.hpp"
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// Estimated memory taken by a chunk in flight, in multiples of its size (text, parsed values, and predictions):
+#define STREAMING_PREDICTOR_CHUNK_FOOTPRINT 3
+
+// Constructors:
+StreamingPredictor::StreamingPredictor(const CompiledForest& forest, int num_threads, size_t chunk_bytes, size_t memory_budget)
+    : forest_(forest)
+{
+    /**
+     * Pipeline for scoring CSV streams.
+     *    forest        : Compiled forest to predict with (must outlive the pipeline).
+     *    num_threads   : Number of worker threads parsing and predicting chunks.
+     *    chunk_bytes   : Number of bytes read at once (a longer line makes a larger chunk).
+     *    memory_budget : Approximate memory for chunks in flight, in bytes (at least two chunks are always allowed).
+     */
+    assert (forest.getNumTrees()>0);
+    assert (num_threads>0);
+    assert (chunk_bytes>0);
+    this->num_threads_ = num_threads;
+    this->chunk_bytes_ = chunk_bytes;
+    this->max_chunks_ = std::max<size_t>(2, memory_budget/(STREAMING_PREDICTOR_CHUNK_FOOTPRINT*chunk_bytes));
+}
+
+// Getters:
+int StreamingPredictor::getMaxChunks() const
+{
+    /** Largest number of chunks read but not written yet (set by the memory budget). */
+    return this->max_chunks_;
+}
+
+// Utilities:
+std::string StreamingPredictor::score_(const std::string& text, long& num_rows) const
+{
+    /** Parse the lines of a chunk into a row-major buffer, predict them at once, and return one prediction per line. */
+    size_t num_features = this->forest_.getNumFeatures();
+    std::vector<double> values;
+    num_rows = 0;
+    const char* position = text.c_str();
+    const char* end = position + text.size();
+    while (position<end)
+    {
+        const char* line_end = std::find(position, end, '\n');
+        size_t num_values = 0;
+        // Empty lines (or carriage returns only) are skipped:
+        if ( (line_end>position) and !( (line_end==position+1) and (*position=='\r') ) ) {
+            while (true)
+            {
+                const char* field_end = std::find(position, line_end, ',');
+                char* parsed;
+                double value = std::strtod(position, &parsed);
+                if ( (parsed==position) or (parsed>field_end) ) {
+                    value = NAN;  // Not a number: missing value.
+                }
+                if (num_values<num_features) {
+                    values.push_back(value);  // Extra value (label) is dropped.
+                }
+                num_values++;
+                if (field_end==line_end) { break; }
+                position = field_end+1;
+            }
+            if ( (num_values!=num_features) and (num_values!=num_features+1) ) {
+                throw std::invalid_argument(
+                    "Expected "+std::to_string(num_features)+" values per line (or one more, with a label), got "+std::to_string(num_values)+"."
+                );
+            }
+            num_rows++;
+        }
+        position = line_end+1;
+    }
+    std::vector<double> predictions(num_rows);
+    if (num_rows>0) {
+        this->forest_.predict(values.data(), num_rows, num_features, num_features, predictions.data());
+    }
+    std::string output;
+    char buffer[32];
+    for (double prediction : predictions)
+    {
+        int length = std::snprintf(buffer, sizeof(buffer), "%.17g\n", prediction);  // Exact round trip.
+        output.append(buffer, length);
+    }
+    return output;
+}
+
+long StreamingPredictor::run(std::istream& input, std::ostream& output) const
+{
+    /**
+     * Score every line of input and write predictions to output in the same order.
+     * Throws the first error of any stage (e.g. a line with the wrong number of values), after stopping all threads.
+     */
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::pair<long,std::string>> pending;  // Chunks read but not scored yet (with their sequence number).
+    std::map<long,std::pair<long,std::string>> scored;  // Predictions of scored chunks (and their number of rows).
+    int in_flight = 0;  // Chunks read but not written yet.
+    bool input_done = false;
+    long num_chunks = 0;  // Number of chunks read (final once input_done).
+    std::exception_ptr error = nullptr;
+
+    // Reader: cut input into chunks ending at a line end (remainder is carried over to the next chunk):
+    std::thread reader([&]() {
+        std::string carry;
+        std::vector<char> buffer(this->chunk_bytes_);
+        long sequence = 0;
+        while (true)
+        {
+            input.read(buffer.data(), buffer.size());
+            size_t count = input.gcount();
+            bool at_end = (count<buffer.size());
+            std::string text = carry;
+            text.append(buffer.data(), count);
+            size_t cut = text.size();
+            if (!at_end) {
+                size_t last_line_end = text.rfind('\n');
+                if (last_line_end==std::string::npos) {
+                    carry = text;  // Line longer than a chunk: keep reading.
+                    continue;
+                }
+                cut = last_line_end+1;
+            }
+            carry = text.substr(cut);
+            text.resize(cut);
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return (in_flight<this->max_chunks_) or (error!=nullptr); });
+            if (error!=nullptr) { break; }
+            if (text.size()>0) {
+                pending.push_back(std::make_pair(sequence++, std::move(text)));
+                in_flight++;
+                changed.notify_all();
+            }
+            if (at_end) { break; }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( input.bad() and (error==nullptr) ) {
+            error = std::make_exception_ptr(std::runtime_error( "Could not read input stream." ));
+        }
+        input_done = true;
+        num_chunks = sequence;
+        changed.notify_all();
+    });
+
+    // Workers: parse and predict chunks in any order:
+    std::vector<std::thread> workers;
+    for (int i = 0; i < this->num_threads_; i++)
+    {
+        workers.emplace_back([&]() {
+            while (true)
+            {
+                std::pair<long,std::string> chunk;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() { return (pending.size()>0) or input_done or (error!=nullptr); });
+                    if ( (error!=nullptr) or (pending.size()==0) ) { return; }
+                    chunk = std::move(pending.front());
+                    pending.pop_front();
+                }
+                long num_rows;
+                std::string predictions;
+                try {
+                    predictions = this->score_(chunk.second, num_rows);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (error==nullptr) { error = std::current_exception(); }
+                    changed.notify_all();
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                scored[chunk.first] = std::make_pair(num_rows, std::move(predictions));
+                changed.notify_all();
+            }
+        });
+    }
+
+    // Writer (this thread): write predictions of each chunk in sequence order:
+    long num_rows = 0;
+    for (long next = 0; true; next++)
+    {
+        std::pair<long,std::string> predictions;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return (scored.count(next)>0) or (error!=nullptr) or (input_done and (next==num_chunks)); });
+            if ( (error!=nullptr) or (scored.count(next)==0) ) { break; }
+            predictions = std::move(scored[next]);
+            scored.erase(next);
+        }
+        output.write(predictions.second.data(), predictions.second.size());
+        num_rows += predictions.first;
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( (!output) and (error==nullptr) ) {
+            error = std::make_exception_ptr(std::runtime_error( "Could not write output stream." ));
+        }
+        in_flight--;
+        changed.notify_all();
+    }
+    output.flush();
+    reader.join();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    if (error!=nullptr) {
+        std::rethrow_exception(error);
+    }
+    return num_rows;
+}
+
+long StreamingPredictor::run(std::string input_filename, std::string output_filename) const
+{
+    /** Score every line of a CSV file and write predictions to another file (returns number of rows). */
+    std::ifstream input(input_filename, std::ios::binary);
+    if (!input.is_open()) {
+        throw std::runtime_error( "Could not open file for reading: "+input_filename );
+    }
+    std::ofstream output(output_filename, std::ios::binary);
+    if (!output.is_open()) {
+        throw std::runtime_error( "Could not open file for writing: "+output_filename );
+    }
+    return this->run(input, output);
+}
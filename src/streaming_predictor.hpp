@@ -0,0 +1,44 @@
+#ifndef STREAMING_PREDICTOR_HPP
+#define STREAMING_PREDICTOR_HPP
+
+#include "compiled_forest.hpp"
+#include <istream>
+#include <ostream>
+
+class StreamingPredictor
+{
+    /**
+     * Scores a CSV stream with a CompiledForest without loading it in memory: one thread reads the input in chunks
+     * (cut at line ends), worker threads parse and predict chunks in parallel, and the calling thread writes the
+     * predictions of each chunk in input order (one per line). Reading stops while the number of chunks in flight
+     * would exceed the memory budget, so the slowest stage sets the pace.
+     * Lines hold numerical values separated by commas (as read by DataLoader), with or without a label column
+     * at the end; values that are not numbers are read as missing values.
+     * */
+
+private:
+
+    // Attributes:
+    const CompiledForest& forest_;  // Forest used for prediction.
+    int num_threads_;  // Number of worker threads parsing and predicting chunks.
+    size_t chunk_bytes_;  // Number of bytes read at once.
+    int max_chunks_;  // Largest number of chunks read but not written yet.
+
+    // Utilities:
+    std::string score_(const std::string& text, long& num_rows) const;  // Parse and predict a chunk of lines, and format predictions.
+
+public:
+
+    // Constructors:
+    StreamingPredictor(const CompiledForest& forest, int num_threads=2, size_t chunk_bytes=1<<20, size_t memory_budget=64<<20);
+
+    // Getters:
+    int getMaxChunks() const;  // Largest number of chunks in flight (set by the memory budget).
+
+    // Utilities:
+    long run(std::istream& input, std::ostream& output) const;  // Score every line of input (returns number of rows).
+    long run(std::string input_filename, std::string output_filename) const;  // Same, from file to file.
+
+};
+
+#endif
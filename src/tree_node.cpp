@@ -12,6 +12,8 @@ TreeNode::TreeNode(DataFrame dataframe)
     this->right_ = nullptr;
     this->dataframe_ = dataframe;
     this->has_split_ = false;
+    this->weight_ = dataframe.length();
+    this->prediction_ = 0;
     //this->split_feature_ = NULL;
     //this->split_threshold_ = NULL;
     TreeNode *root = this->findRoot();
@@ -28,6 +30,8 @@ TreeNode::TreeNode(DataFrame dataframe, int split_feature, double split_threshol
     this->right_ = nullptr;
     this->dataframe_ = dataframe;
     this->has_split_ = false;
+    this->weight_ = dataframe.length();
+    this->prediction_ = 0;
     //this->split_feature_ = NULL;
     //this->split_threshold_ = NULL;
     TreeNode *root = this->findRoot();
@@ -46,6 +50,8 @@ TreeNode::TreeNode(TreeNode *parent, TreeNode *left, TreeNode *right, DataFrame
     this->has_split_ = true;
     this->split_feature_ = split_feature;
     this->split_threshold_ = split_threshold;
+    this->weight_ = dataframe.length();
+    this->prediction_ = 0;
     TreeNode *root = this->findRoot();
     root->updateSizes();
     root->updateHeights();
@@ -60,6 +66,8 @@ TreeNode::TreeNode(TreeNode *parent, TreeNode *left, TreeNode *right)
     this->right_ = right;
     //this->dataframe_ = NULL;
     this->has_split_ = false;
+    this->weight_ = 0;
+    this->prediction_ = 0;
     //this->split_feature_ = NULL;
     //this->split_threshold_ = NULL;
     TreeNode *root = this->findRoot();
@@ -75,6 +83,8 @@ TreeNode::TreeNode()
     this->left_ = nullptr;
     this->right_ = nullptr;
     this->has_split_ = false;
+    this->weight_ = 0;
+    this->prediction_ = 0;
     TreeNode *root = this->findRoot();
     root->updateSizes();
     root->updateHeights();
@@ -187,6 +197,30 @@ double TreeNode::getSplitThreshold() const
     return this->split_threshold_;
 }
 
+int TreeNode::getWeight() const
+{
+    /**
+     * Get number of training observations at this node (counting repeated rows).
+     */
+    return this->weight_;
+}
+
+double TreeNode::getPrediction() const
+{
+    /**
+     * Get prediction at this node (mean value or majority class of its training data).
+     */
+    return this->prediction_;
+}
+
+const std::vector<double>& TreeNode::getDistribution() const
+{
+    /**
+     * Get proportion of each class in the training data at this node (in order of sorted class labels).
+     */
+    return this->distribution_;
+}
+
 // Setters:
 
 void TreeNode::setLeft(TreeNode *left)
@@ -221,6 +255,25 @@ void TreeNode::setRight(TreeNode *right)
     root->updateDepths();
 }
 
+void TreeNode::setChildren(TreeNode *left, TreeNode *right)
+{
+    /**
+     * Set pointers to both children (or remove them, with nullptr for both, so that this node becomes a leaf),
+     * without updating sizes, heights and depths: many nodes can be changed in one pass, after which
+     * the update functions are called on the root. Children may be shared with other nodes (e.g. identical
+     * subtrees of several trees), in which case their parent is the last node linked to them.
+     */
+    assert ( (left==nullptr) == (right==nullptr) );
+    this->left_ = left;
+    this->right_ = right;
+    if (left!=nullptr) {
+        left->parent_ = this;
+        right->parent_ = this;
+    } else {
+        this->has_split_ = false;
+    }
+}
+
 void TreeNode::setDataFrame(DataFrame dataframe)
 {
     /**
@@ -247,6 +300,30 @@ void TreeNode::setSplitThreshold(double split_threshold)
     this->split_threshold_ = split_threshold;
 }
 
+void TreeNode::setWeight(int weight)
+{
+    /**
+     * Set number of training observations at this node (counting repeated rows).
+     */
+    this->weight_ = weight;
+}
+
+void TreeNode::setPrediction(double prediction)
+{
+    /**
+     * Set prediction at this node.
+     */
+    this->prediction_ = prediction;
+}
+
+void TreeNode::setDistribution(std::vector<double> distribution)
+{
+    /**
+     * Set proportion of each class in the training data at this node.
+     */
+    this->distribution_ = distribution;
+}
+
 // Utilities:
 
 TreeNode * TreeNode::findRoot()
@@ -23,6 +23,9 @@ private:
     bool has_split_;  // Flag indicating whether splitting values have been set.
     int split_feature_;  // Index of splitting column.
     double split_threshold_;  // Numerical splitting threshold.
+    int weight_;  // Number of training observations at this node (counting repeated rows).
+    double prediction_;  // Prediction at this node (mean value or majority class of its training data).
+    std::vector<double> distribution_;  // Proportion of each class in its training data (classification only).
 
 public:
 
@@ -48,13 +51,20 @@ public:
     DataFrame getDataFrame() const;
     int getSplitFeature() const;
     double getSplitThreshold() const;
+    int getWeight() const;
+    double getPrediction() const;
+    const std::vector<double>& getDistribution() const;
 
     // Setters:
     void setLeft(TreeNode *left);
     void setRight(TreeNode *right);
+    void setChildren(TreeNode *left, TreeNode *right);
     void setDataFrame(DataFrame dataframe);
     void setSplitFeature(int split_feature);
     void setSplitThreshold(double split_threshold);
+    void setWeight(int weight);
+    void setPrediction(double prediction);
+    void setDistribution(std::vector<double> distribution);
 
     // Utilities:
     TreeNode * findRoot();
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <dlfcn.h>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/code_generator.cpp"
+
+typedef void (*BatchFunction)(const double*, long, long, double*);
+
+static std::vector<double> predict_generated(const std::string& code, const std::string& function_name, const DataFrame& data){
+    /** Build generated code into a shared object (compiler taken from $CXX, default g++), load it and predict all rows of data. */
+    std::string source_path = "./test_code_generator_" + function_name + ".cpp";
+    std::string library_path = "./test_code_generator_" + function_name + ".so";
+    std::ofstream source(source_path);
+    source << code;
+    source.close();
+    const char* compiler = std::getenv("CXX");
+    std::string command = std::string(compiler ? compiler : "g++") + " -std=c++14 -O1 -shared -fPIC " + source_path + " -o " + library_path;
+    int status = std::system(command.c_str());
+    assert (status==0);
+    void* library = dlopen(library_path.c_str(), RTLD_NOW);
+    assert (library!=nullptr);
+    BatchFunction predict_batch = (BatchFunction) dlsym(library, (function_name+"_batch").c_str());
+    assert (predict_batch!=nullptr);
+    // Features of all rows, stored contiguously (label column included, so stride is the width of data):
+    std::vector<double> features;
+    for (int i = 0; i < data.length(); i++)
+    {
+        const double* row = data.row(i)->data();
+        features.insert(features.end(), row, row+data.width());
+    }
+    std::vector<double> predictions(data.length());
+    predict_batch(features.data(), data.length(), data.width(), predictions.data());
+    dlclose(library);
+    std::remove(source_path.c_str());
+    std::remove(library_path.c_str());
+    return predictions;
+}
+
+
+int main(){
+
+    std::cout << "Define training data:" << std::endl;
+    DataFrame training_data = DataFrame({
+        {2.232, 2.456, 2.000, 0},
+        {2.232, 2.456, 3.000, 1},
+        {2.277, 8.735, 3.000, 2},
+        {2.965, 6.846, 3.000, 2},
+        {2.252, 6.452, 3.000, 2},
+        {2.222, 9.944, 3.000, 2},
+        {2.322, 8.747, 3.000, 2},
+        {2.322, 7.667, 3.000, 2},
+        {6.201, 6.342, 3.000, 3},
+        {6.201, 7.442, 3.000, 3},
+        {7.403, 9.944, 3.000, 3},
+        {8.720, 8.747, 3.000, 3},
+        {6.804, 9.941, 3.000, 3},
+        {6.201, 9.452, 3.000, 3},
+        {8.403, 3.944, 3.000, 4},
+        {8.403, 3.944, 4.000, 5},
+    });
+    training_data.print();
+
+    std::cout << "Generate code for a classification tree:" << std::endl;
+    DecisionTree classification_tree = DecisionTree(training_data,false,"gini_impurity",-1,-1,-1,-1,-1);
+    std::cout << classification_tree << std::endl;
+    std::string tree_code = generate_cpp(classification_tree, "score_tree");
+    std::cout << tree_code << std::endl;
+    assert (tree_code.find("extern \"C\" double score_tree(const double* x)")!=std::string::npos);
+    assert (tree_code.find("extern \"C\" void score_tree_batch(")!=std::string::npos);
+
+    std::cout << "Generate code for a regression forest:" << std::endl;
+    RandomForest rf_regression = RandomForest(training_data,3,true,"mean_squared_error",-1,3,-1,-1,-1,42);
+    std::string forest_code = generate_cpp(rf_regression);
+    std::cout << forest_code << std::endl;
+    assert (forest_code.find("return sum / 3;")!=std::string::npos);
+
+    std::cout << "Write non-finite values as valid C++:" << std::endl;
+    assert (cpp_literal(2.0)=="2.0");
+    assert (cpp_literal(HUGE_VAL)=="HUGE_VAL");
+    assert (cpp_literal(-HUGE_VAL)=="-HUGE_VAL");
+    assert (cpp_literal(std::numeric_limits<double>::quiet_NaN())=="std::numeric_limits<double>::quiet_NaN()");
+    DataFrame infinite_data = DataFrame({
+        {-HUGE_VAL, 0},
+        {-HUGE_VAL, 0},
+        {1.0, 1},
+        {2.0, 1},
+    });
+    DecisionTree infinite_tree = DecisionTree(infinite_data,false,"gini_impurity",-1,-1,-1,-1,-1);
+    std::vector<double> infinite_predictions = predict_generated(generate_cpp(infinite_tree, "score_infinite"), "score_infinite", infinite_data);
+    std::cout << infinite_tree << std::endl;
+    assert (infinite_tree.getRoot()->getSplitThreshold()==-HUGE_VAL);
+    assert (infinite_predictions==infinite_tree.predict(&infinite_data).vector());
+
+    std::cout << "Build generated code and compare with DecisionTree::predict and RandomForest::predict:" << std::endl;
+    std::vector<std::pair<std::string,bool>> datasets = {
+        {"../data/hmeq_clean.csv", false},
+        {"../data/sonar.all-data.numerical.csv", true},
+    };
+    for (const std::pair<std::string,bool>& dataset : datasets)
+    {
+        DataFrame data = DataLoader(dataset.first).load();
+        bool regression = dataset.second;
+        std::string loss = regression ? "mean_squared_error" : "gini_impurity";
+        DecisionTree data_tree = DecisionTree(data,regression,loss,-1,6,-1,-1,-1,42,"histogram");  // Histogram splits keep the test fast.
+        std::vector<double> tree_predictions = predict_generated(generate_cpp(data_tree, "score_data_tree"), "score_data_tree", data);
+        bool same_tree = (tree_predictions==data_tree.predict(&data).vector());
+        std::cout << dataset.first << " (DecisionTree): " << same_tree << std::endl;
+        assert (same_tree);
+        RandomForest data_forest = RandomForest(data,5,regression,loss,-1,6,-1,-1,-1,42,"histogram");
+        std::vector<double> forest_predictions = predict_generated(generate_cpp(data_forest, "score_data_forest"), "score_data_forest", data);
+        bool same_forest = (forest_predictions==data_forest.predict(&data).vector());
+        std::cout << dataset.first << " (RandomForest): " << same_forest << std::endl;
+        assert (same_forest);
+    }
+
+    return 0;
+};
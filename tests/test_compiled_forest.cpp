@@ -0,0 +1,205 @@
+#include <iostream>
+#include <cstdio>
+#include <fstream>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/compiled_forest.cpp"
+
+
+int main(){
+
+    int num_trees = 10;
+
+    std::cout << "Define training data:" << std::endl;
+    DataFrame training_data = DataFrame({
+        {2.232, 2.456, 2.000, 0},
+        {2.232, 2.456, 3.000, 1},
+        {2.277, 8.735, 3.000, 2},
+        {2.965, 6.846, 3.000, 2},
+        {2.252, 6.452, 3.000, 2},
+        {2.222, 9.944, 3.000, 2},
+        {2.322, 8.747, 3.000, 2},
+        {2.322, 7.667, 3.000, 2},
+        {6.201, 6.342, 3.000, 3},
+        {6.201, 7.442, 3.000, 3},
+        {7.403, 9.944, 3.000, 3},
+        {8.720, 8.747, 3.000, 3},
+        {6.804, 9.941, 3.000, 3},
+        {6.201, 9.452, 3.000, 3},
+        {8.403, 3.944, 3.000, 4},
+        {8.403, 3.944, 4.000, 5},
+    });
+    training_data.print();
+
+    std::cout << "Define test data:" << std::endl;
+    DataFrame test_data = DataFrame({
+        {2.0, 0.0, 3.0},  // Expected: 1.
+        {2.0, 1.0, 3.0},  // Expected: 1.
+        {2.0, 2.0, 3.0},  // Expected: 1.
+        {2.0, 7.0, 3.0},  // Expected: 2.
+        {2.0, 8.0, 3.0},  // Expected: 2.
+        {2.0, 9.0, 3.0},  // Expected: 2.
+        {7.0, 7.0, 3.0},  // Expected: 3.
+        {7.0, 8.0, 3.0},  // Expected: 3.
+        {7.0, 9.0, 3.0},  // Expected: 3.
+        {7.0, 1.0, 3.0},  // Expected: 4.
+        {7.0, 2.0, 3.0},  // Expected: 4.
+    });
+    test_data.print();
+
+    std::cout << "Compile a DecisionTree:" << std::endl;
+    DecisionTree tree = DecisionTree(training_data,false,"gini_impurity",-1,-1,-1,-1,-1);
+    CompiledForest compiled_tree = CompiledForest(tree);
+    std::cout << "Number of nodes: " << compiled_tree.getNumNodes() << std::endl;
+    assert (compiled_tree.getNumNodes()==tree.getSize());
+    assert (compiled_tree.getClasses()==tree.getClasses());
+    DataVector pred_tree = compiled_tree.predict(&test_data);
+    std::cout << pred_tree << std::endl;
+    assert (pred_tree.vector()==tree.predict(&test_data).vector());
+
+    std::cout << "Compile a RandomForest for classification:" << std::endl;
+    RandomForest rf_classification = RandomForest(training_data,num_trees,false,"gini_impurity",-1,-1,-1,-1,-1,42);
+    CompiledForest compiled_classification = CompiledForest(rf_classification);
+    std::cout << "Number of trees: " << compiled_classification.getNumTrees() << std::endl;
+    DataVector pred_classification = compiled_classification.predict(&test_data);
+    std::cout << pred_classification << std::endl;
+    assert (pred_classification.vector()==rf_classification.predict(&test_data).vector());
+
+    std::cout << "Compile a RandomForest for regression:" << std::endl;
+    RandomForest rf_regression = RandomForest(training_data,num_trees,true,"mean_squared_error",-1,-1,-1,-1,-1,42);
+    CompiledForest compiled_regression = CompiledForest(rf_regression);
+    DataVector pred_regression = compiled_regression.predict(&test_data);
+    std::cout << pred_regression << std::endl;
+    assert (pred_regression.vector()==rf_regression.predict(&test_data).vector());
+
+    std::cout << "Predict in groups of 3 and blocks of 4 observations (same predictions):" << std::endl;
+    compiled_regression.setGroupSize(3);
+    compiled_regression.setBlockSize(4);
+    assert (compiled_regression.predict(&test_data).vector()==pred_regression.vector());
+    for (int i = 0; i < test_data.length(); i++)
+    {
+        assert (compiled_regression.predict(test_data.row(i)->data())==pred_regression.value(i));
+    }
+    std::vector<double> rows;
+    for (int i = 0; i < test_data.length(); i++)
+    {
+        rows.insert(rows.end(), test_data.row(i)->data(), test_data.row(i)->data()+test_data.width());
+    }
+    std::vector<double> output(test_data.length());
+    compiled_regression.predict(rows.data(), test_data.length(), test_data.width(), test_data.width(), output.data());
+    assert (output==pred_regression.vector());
+
+    std::cout << "Predict single observations with every supported SIMD width (same predictions, across chunks of trees):" << std::endl;
+    RandomForest rf_many_trees = RandomForest(training_data,137,false,"gini_impurity",-1,-1,-1,-1,-1,42);
+    CompiledForest compiled_many_trees = CompiledForest(rf_many_trees);
+    DataVector pred_many_trees = rf_many_trees.predict(&test_data);
+    int widest_simd_width = compiled_many_trees.getSimdWidth();
+    std::cout << "Widest SIMD kernel: " << widest_simd_width << " trees" << std::endl;
+    for (int simd_width : {16, 8, 1})
+    {
+        if (simd_width>widest_simd_width) { continue; }
+        compiled_many_trees.setSimdWidth(simd_width);
+        for (int i = 0; i < test_data.length(); i++)
+        {
+            assert (compiled_many_trees.predict(test_data.row(i)->data())==pred_many_trees.value(i));
+        }
+    }
+
+    std::cout << "Compile depth-limited trees as complete binary trees:" << std::endl;
+    RandomForest rf_depth_limited = RandomForest(training_data,num_trees,true,"mean_squared_error",-1,3,-1,-1,-1,42);
+    CompiledForest compiled_perfect = CompiledForest(rf_depth_limited);
+    CompiledForest compiled_pointers = CompiledForest(rf_depth_limited, "traversal", -1);
+    std::cout << "Complete trees: " << compiled_perfect.getNumPerfectTrees() << " and " << compiled_pointers.getNumPerfectTrees() << std::endl;
+    assert (compiled_perfect.getNumPerfectTrees()==num_trees);
+    assert (compiled_pointers.getNumPerfectTrees()==0);
+    DataVector pred_perfect = compiled_perfect.predict(&test_data);
+    std::cout << pred_perfect << std::endl;
+    assert (pred_perfect.vector()==rf_depth_limited.predict(&test_data).vector());
+    assert (pred_perfect.vector()==compiled_pointers.predict(&test_data).vector());
+
+    std::cout << "Compile a RandomForest with the QuickScorer engine:" << std::endl;
+    RandomForest rf_shallow = RandomForest(training_data,num_trees,false,"gini_impurity",-1,3,-1,-1,-1,42);
+    CompiledForest compiled_quickscorer = CompiledForest(rf_shallow, "quickscorer");
+    std::cout << "Engine: " << compiled_quickscorer.getEngine() << std::endl;
+    DataVector pred_quickscorer = compiled_quickscorer.predict(&test_data);
+    std::cout << pred_quickscorer << std::endl;
+    assert (pred_quickscorer.vector()==rf_shallow.predict(&test_data).vector());
+    CompiledForest compiled_quickscorer_regression = CompiledForest(rf_regression, "quickscorer");
+    assert (compiled_quickscorer_regression.predict(&test_data).vector()==pred_regression.vector());
+
+    std::cout << "Lay out nodes again from a sample of observations (same predictions):" << std::endl;
+    compiled_classification.profile(&test_data);
+    assert (compiled_classification.predict(&test_data).vector()==pred_classification.vector());
+    compiled_perfect.profile(&test_data);
+    assert (compiled_perfect.getNumPerfectTrees()==num_trees);
+    assert (compiled_perfect.predict(&test_data).vector()==pred_perfect.vector());
+    compiled_quickscorer.profile(&test_data);
+    assert (compiled_quickscorer.predict(&test_data).vector()==pred_quickscorer.vector());
+    compiled_many_trees.profile(&test_data);
+    for (int i = 0; i < test_data.length(); i++)
+    {
+        assert (compiled_many_trees.predict(test_data.row(i)->data())==pred_many_trees.value(i));
+    }
+
+    std::cout << "Save and load a compiled forest (same predictions), and reject a corrupted depth:" << std::endl;
+    compiled_perfect.save("test_compiled_forest.forest");
+    assert (CompiledForest::load("test_compiled_forest.forest").predict(&test_data).vector()==pred_perfect.vector());
+    {
+        // Depths follow magic, options (5 int), engine name, class labels (none) and roots (each with an int64 length):
+        std::fstream file("test_compiled_forest.forest", std::ios::in | std::ios::out | std::ios::binary);
+        int depth = 31;
+        file.seekp(8 + 8+5*sizeof(int) + 8+compiled_perfect.getEngine().size() + 8 + 8+num_trees*sizeof(int) + 8);
+        file.write(reinterpret_cast<const char*>(&depth), sizeof(depth));
+    }
+    bool rejected = false;
+    try {
+        CompiledForest::load("test_compiled_forest.forest");
+    } catch (const std::runtime_error& error) {
+        std::cout << error.what() << std::endl;
+        rejected = true;
+    }
+    assert (rejected);
+    std::remove("test_compiled_forest.forest");
+
+    std::cout << "Compile forests trained on the example datasets (same predictions as RandomForest::predict):" << std::endl;
+    std::vector<std::pair<std::string,bool>> datasets = {
+        {"../data/hmeq_clean.csv", false},
+        {"../data/cancer_clean.csv", false},
+        {"../data/sonar.all-data.numerical.csv", true},
+    };
+    for (const std::pair<std::string,bool>& dataset : datasets)
+    {
+        DataFrame data = DataLoader(dataset.first).load();
+        bool regression = dataset.second;
+        std::string loss = regression ? "mean_squared_error" : "gini_impurity";
+        for (int max_height : {6, -1})
+        {
+            RandomForest rf_data = RandomForest(data,num_trees,regression,loss,-1,max_height,-1,-1,-1,42,"histogram");  // Histogram splits keep the test fast.
+            std::vector<double> expected = rf_data.predict(&data).vector();
+            std::vector<CompiledForest> compiled_data = {
+                CompiledForest(rf_data),
+                CompiledForest(rf_data, "traversal", -1),
+            };
+            if (max_height>0) {
+                compiled_data.push_back(CompiledForest(rf_data, "quickscorer"));  // At most 64 leaves per tree.
+            }
+            for (const CompiledForest& compiled : compiled_data)
+            {
+                std::vector<double> predictions = compiled.predict(&data).vector();
+                bool same = (predictions==expected);
+                for (int i = 0; i < data.length(); i++)
+                {
+                    same = same and (compiled.predict(data.row(i)->data())==expected[i]);
+                }
+                std::cout << dataset.first << " (max height " << max_height << ", engine " << compiled.getEngine()
+                    << ", " << compiled.getNumPerfectTrees() << " complete trees): " << same << std::endl;
+                assert (same);
+            }
+        }
+    }
+
+    return 0;
+};
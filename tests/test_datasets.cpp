@@ -1,4 +1,5 @@
 #include <iostream>
+#include <numeric>
 #include "../src/datasets.cpp"
 
 int main(){
@@ -91,10 +92,43 @@ int main(){
     DataFrame df_boot_without = df_test.sample(1000000, 42, false);
     df_boot_without.print(4);
     assert(df_boot_without.length() == df_test.length());
+    // Same bootstrap as a count of draws per row
+    std::cout << "Bootstrap small sample as row counts:" << std::endl;
+    std::vector<int> boot_counts = df_test.sample_counts(5, 1337);
+    for (int count : boot_counts){ std::cout << count << " "; }
+    std::cout << std::endl;
+    assert(std::accumulate(boot_counts.begin(), boot_counts.end(), 0) == df_boot.length());
 
     // Testing train-test split
     std::cout << "Train-test split:" << std::endl;
     std::vector<DataFrame> train_test_vector = df_test.train_test_split(0.3, 1729);
     std::cout << "Train:\n" << train_test_vector[0] << std::endl;
     std::cout << "Test:\n" << train_test_vector[1] << std::endl;
+
+    // Testing rank encoding (features only):
+    std::cout << "Rank-encoded features:" << std::endl;
+    RankedDataFrame df_ranked = RankedDataFrame(df_test, df_test.width()-1);
+    for (int r = 0; r < df_ranked.length(); r++)
+    {
+        std::cout << df_ranked.rank(r,0) << " " << df_ranked.rank(r,1) << std::endl;
+        assert (df_ranked.value(0, df_ranked.rank(r,0)) == df_test.value(r,0));
+    }
+    std::cout << "Unique values in first column: " << df_ranked.num_ranks(0) << std::endl;
+    std::cout << "Encode unseen value 5.0 in first column: " << df_ranked.encode(0, 5.0) << std::endl;
+    std::cout << "Rows sorted by first column:";
+    for (int r : df_ranked.sorted_rows(0)) { std::cout << " " << r; }
+    std::cout << std::endl;
+    std::cout << "Decoded features:\n" << df_ranked.decode() << std::endl;
+
+    // Testing quantile binning (features only, 4 bins):
+    std::cout << "Binned features (4 bins):" << std::endl;
+    BinnedDataFrame df_binned = BinnedDataFrame(df_test, df_test.width()-1, 4);
+    std::cout << "Bin boundaries of first column:";
+    for (double upper : df_binned.boundaries(0)) { std::cout << " " << upper; }
+    std::cout << std::endl;
+    for (int r = 0; r < df_binned.length(); r++)
+    {
+        std::cout << int(df_binned.bin(r,0)) << " " << int(df_binned.bin(r,1)) << std::endl;
+        assert (df_test.value(r,0) <= df_binned.upper(0, df_binned.bin(r,0)));
+    }
 };
\ No newline at end of file
@@ -67,12 +67,81 @@ int main(){
     std::cout << "Predictions :" << std::endl;
     std::cout << test_predictions << std::endl;
 
+    // Predict single observations from raw values:
+    double features[3] = {7.0, 1.0, 3.0};
+    double output;
+    classification_tree.predict_one(features, 3, &output);
+    std::cout << "Prediction for (7,1,3) : " << classification_tree.predict_one(features, 3) << std::endl;
+    assert (output==test_predictions.value(-2));
+
+    // Predict class probabilities (leaves of a fully grown tree are pure):
+    DataFrame probabilities = classification_tree.predict_proba(&test_data);
+    std::cout << "Probabilities of classes " << DataVector(classification_tree.getClasses()) << probabilities << std::endl;
+
     // Print classification tree:
     std::cout << classification_tree << std::endl;
 
+    // Presorted split search should build exactly the same tree:
+    DecisionTree presorted_tree = DecisionTree(training_data,false,"gini_impurity",-1,-1,-1,-1,-1,-1,"presorted");
+    std::cout << "Presorted tree matches exact tree: " << (presorted_tree.to_string()==classification_tree.to_string()) << std::endl;
+    assert (presorted_tree.to_string()==classification_tree.to_string());
+
+    // Histogram split search (every feature here has few enough unique values to get one bin per value):
+    DecisionTree histogram_tree = DecisionTree(training_data,false,"gini_impurity",-1,-1,-1,-1,-1,-1,"histogram");
+    std::cout << "Histogram tree predictions :" << std::endl;
+    std::cout << histogram_tree.predict(&test_data) << std::endl;
+    // Shared binned data is indexed by row position, so it must be built from the training data itself:
+    std::shared_ptr<const BinnedDataFrame> other_binned = std::make_shared<const BinnedDataFrame>(test_data, test_data.width());
+    bool rejected = false;
+    try {
+        DecisionTree(training_data,false,"gini_impurity",-1,-1,-1,-1,-1,-1,"histogram",{},nullptr,other_binned);
+    } catch (const std::invalid_argument& error) {
+        rejected = true;
+    }
+    assert (rejected);
+
+    // Sample weights should give the same tree as duplicating rows:
+    std::vector<int> counts = training_data.sample_counts(-1, 1337);
+    DecisionTree weighted_tree = DecisionTree(training_data,false,"gini_impurity",-1,-1,-1,-1,-1,-1,"exact",counts);
+    DecisionTree bootstrap_tree = DecisionTree(training_data.sample(-1, 1337),false,"gini_impurity",-1,-1,-1,-1,-1,-1,"exact");
+    std::cout << "Weighted tree matches tree on bootstrap sample: " << (weighted_tree.to_string()==bootstrap_tree.to_string()) << std::endl;
+    assert (weighted_tree.to_string()==bootstrap_tree.to_string());
+
     // Print regression tree:
     DecisionTree regression_tree = DecisionTree(training_data,true,"mean_squared_error",-1,-1,-1,-1,-1);
     std::cout << regression_tree << std::endl;
 
+    // Presorted split search should also build exactly the same regression trees (near-ties included):
+    DecisionTree presorted_regression_tree = DecisionTree(training_data,true,"mean_squared_error",-1,-1,-1,-1,-1,-1,"presorted");
+    assert (presorted_regression_tree.to_string()==regression_tree.to_string());
+    DataLoader sonar_loader = DataLoader("../data/sonar.all-data.numerical.csv");
+    DataFrame sonar_data = sonar_loader.load();
+    for (int max_height : {3, 6, -1})
+    {
+        DecisionTree exact_sonar_tree = DecisionTree(sonar_data,true,"mean_squared_error",-1,max_height,-1,-1,-1,-1,"exact");
+        DecisionTree presorted_sonar_tree = DecisionTree(sonar_data,true,"mean_squared_error",-1,max_height,-1,-1,-1,-1,"presorted");
+        bool same = (presorted_sonar_tree.to_string()==exact_sonar_tree.to_string());
+        same = same and (presorted_sonar_tree.predict(&sonar_data).vector()==exact_sonar_tree.predict(&sonar_data).vector());
+        std::cout << "Presorted regression tree matches exact tree on sonar data (max height " << max_height << "): " << same << std::endl;
+        assert (same);
+    }
+
+    // Sample weights should give the same regression tree as duplicating rows in place (same sums, so same splits and leaf means):
+    for (int seed : {1, 2})
+    {
+        std::vector<int> sonar_counts = sonar_data.sample_counts(-1, seed);
+        DataFrame bootstrap_data = DataFrame();
+        for (int i = 0; i < sonar_data.length(); i++)
+        {
+            for (int k = 0; k < sonar_counts[i]; k++){ bootstrap_data.addRow(sonar_data.row(i)); }
+        }
+        DecisionTree weighted_regression_tree = DecisionTree(sonar_data,true,"mean_squared_error",-1,-1,-1,-1,-1,-1,"exact",sonar_counts);
+        DecisionTree bootstrap_regression_tree = DecisionTree(bootstrap_data,true,"mean_squared_error",-1,-1,-1,-1,-1,-1,"exact");
+        bool same = (weighted_regression_tree.to_string()==bootstrap_regression_tree.to_string());
+        same = same and (weighted_regression_tree.predict(&sonar_data).vector()==bootstrap_regression_tree.predict(&sonar_data).vector());
+        std::cout << "Weighted regression tree matches tree on bootstrap sample (seed " << seed << "): " << same << std::endl;
+        assert (same);
+    }
+
     return 0;
 };
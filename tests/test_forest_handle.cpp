@@ -0,0 +1,148 @@
+#include <iostream>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/compiled_forest.cpp"
+#include "../src/forest_handle.cpp"
+#include <thread>
+
+
+int main(){
+
+    int num_trees = 10;
+
+    std::cout << "Define training data:" << std::endl;
+    DataFrame training_data = DataFrame({
+        {2.232, 2.456, 2.000, 0},
+        {2.232, 2.456, 3.000, 1},
+        {2.277, 8.735, 3.000, 2},
+        {2.965, 6.846, 3.000, 2},
+        {2.252, 6.452, 3.000, 2},
+        {2.222, 9.944, 3.000, 2},
+        {2.322, 8.747, 3.000, 2},
+        {2.322, 7.667, 3.000, 2},
+        {6.201, 6.342, 3.000, 3},
+        {6.201, 7.442, 3.000, 3},
+        {7.403, 9.944, 3.000, 3},
+        {8.720, 8.747, 3.000, 3},
+        {6.804, 9.941, 3.000, 3},
+        {6.201, 9.452, 3.000, 3},
+        {8.403, 3.944, 3.000, 4},
+        {8.403, 3.944, 4.000, 5},
+    });
+    training_data.print();
+
+    std::cout << "Define test data:" << std::endl;
+    DataFrame test_data = DataFrame({
+        {2.0, 0.0, 3.0},  // Expected: 1.
+        {2.0, 1.0, 3.0},  // Expected: 1.
+        {2.0, 2.0, 3.0},  // Expected: 1.
+        {2.0, 7.0, 3.0},  // Expected: 2.
+        {2.0, 8.0, 3.0},  // Expected: 2.
+        {2.0, 9.0, 3.0},  // Expected: 2.
+        {7.0, 7.0, 3.0},  // Expected: 3.
+        {7.0, 8.0, 3.0},  // Expected: 3.
+        {7.0, 9.0, 3.0},  // Expected: 3.
+        {7.0, 1.0, 3.0},  // Expected: 4.
+        {7.0, 2.0, 3.0},  // Expected: 4.
+    });
+    test_data.print();
+
+    std::cout << "Compile two forests:" << std::endl;
+    RandomForest rf_first = RandomForest(training_data,num_trees,true,"mean_squared_error",-1,-1,-1,-1,-1,42);
+    RandomForest rf_second = RandomForest(training_data,num_trees,true,"mean_squared_error",-1,2,-1,-1,-1,7);
+    std::shared_ptr<const CompiledForest> first = std::make_shared<const CompiledForest>(rf_first);
+    std::shared_ptr<const CompiledForest> second = std::make_shared<const CompiledForest>(rf_second);
+    std::vector<double> pred_first = rf_first.predict(&test_data).vector();
+    std::vector<double> pred_second = rf_second.predict(&test_data).vector();
+    std::cout << DataVector(pred_first, false) << std::endl;
+    std::cout << DataVector(pred_second, false) << std::endl;
+    assert (pred_first!=pred_second);
+
+    std::cout << "Predict through a handle:" << std::endl;
+    ForestHandle handle(first);
+    uint64_t generation = handle.getGeneration();
+    assert (handle.predict(&test_data).vector()==pred_first);
+    assert (handle.load()==first);
+
+    std::cout << "Swap forests while other threads predict (each call uses one forest or the other):" << std::endl;
+    std::atomic<bool> swapping(true);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; r++)
+    {
+        readers.emplace_back([&]() {
+            while (swapping)
+            {
+                std::vector<double> predictions = handle.predict(&test_data).vector();
+                assert ( (predictions==pred_first) or (predictions==pred_second) );
+                for (int i = 0; i < test_data.length(); i++)
+                {
+                    double prediction = handle.predict(test_data.row(i)->data());
+                    assert ( (prediction==pred_first[i]) or (prediction==pred_second[i]) );
+                }
+            }
+        });
+    }
+    for (int k = 0; k < 200; k++)
+    {
+        std::shared_ptr<const CompiledForest> previous = handle.swap( (k%2==0) ? second : first );
+        assert (previous==( (k%2==0) ? first : second ));
+    }
+    swapping = false;
+    for (std::thread& reader : readers)
+    {
+        reader.join();
+    }
+
+    std::cout << "Latest forest is used after the last swap:" << std::endl;
+    assert (handle.getGeneration()!=generation);
+    assert (handle.load()==first);
+    assert (handle.predict(&test_data).vector()==pred_first);
+    handle.swap(second);
+    assert (handle.predict(&test_data).vector()==pred_second);
+    std::vector<double> output(test_data.length());
+    handle.predict(test_data.row(0)->data(), 1, test_data.width(), test_data.width(), output.data());
+    assert (output[0]==pred_second[0]);
+
+    std::cout << "Alternate between handles on one thread (each keeps its own forest):" << std::endl;
+    ForestHandle other_handle(first);
+    for (int k = 0; k < 3; k++)
+    {
+        assert (handle.predict(&test_data).vector()==pred_second);
+        assert (other_handle.predict(&test_data).vector()==pred_first);
+    }
+    other_handle.swap(second);
+    assert (other_handle.predict(&test_data).vector()==pred_second);
+    assert (handle.predict(&test_data).vector()==pred_second);
+
+    std::cout << "Swapped-out forest is released by a thread at its next call, or when it releases its pins:" << std::endl;
+    std::weak_ptr<const CompiledForest> replaced;
+    {
+        std::shared_ptr<const CompiledForest> third = std::make_shared<const CompiledForest>(rf_first);
+        replaced = third;
+        ForestHandle released_handle(third);
+        std::atomic<int> step(0);
+        std::thread idle_reader([&]() {
+            assert (released_handle.predict(&test_data).vector()==pred_first);
+            step = 1;
+            while (step!=2) { std::this_thread::yield(); }  // Idle while the forest is swapped out.
+            ForestHandle::releasePinned();
+            step = 3;
+        });
+        while (step!=1) { std::this_thread::yield(); }
+        released_handle.predict(&test_data);
+        third = nullptr;
+        released_handle.swap(second);
+        assert (!replaced.expired());  // Still pinned by both threads.
+        assert (released_handle.predict(&test_data).vector()==pred_second);
+        assert (!replaced.expired());  // Still pinned by the idle thread.
+        step = 2;
+        while (step!=3) { std::this_thread::yield(); }
+        assert (replaced.expired());
+        idle_reader.join();
+    }
+
+    return 0;
+};
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <cstdio>
+#include <cstddef>
+#include <fstream>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/compiled_forest.cpp"
+#include "../src/lazy_forest.cpp"
+
+
+int main(){
+
+    int num_trees = 10;
+
+    std::cout << "Define training data:" << std::endl;
+    DataFrame training_data = DataFrame({
+        {2.232, 2.456, 2.000, 0},
+        {2.232, 2.456, 3.000, 1},
+        {2.277, 8.735, 3.000, 2},
+        {2.965, 6.846, 3.000, 2},
+        {2.252, 6.452, 3.000, 2},
+        {2.222, 9.944, 3.000, 2},
+        {2.322, 8.747, 3.000, 2},
+        {2.322, 7.667, 3.000, 2},
+        {6.201, 6.342, 3.000, 3},
+        {6.201, 7.442, 3.000, 3},
+        {7.403, 9.944, 3.000, 3},
+        {8.720, 8.747, 3.000, 3},
+        {6.804, 9.941, 3.000, 3},
+        {6.201, 9.452, 3.000, 3},
+        {8.403, 3.944, 3.000, 4},
+        {8.403, 3.944, 4.000, 5},
+    });
+    training_data.print();
+
+    std::cout << "Define test data:" << std::endl;
+    DataFrame test_data = DataFrame({
+        {2.0, 0.0, 3.0},  // Expected: 1.
+        {2.0, 1.0, 3.0},  // Expected: 1.
+        {2.0, 2.0, 3.0},  // Expected: 1.
+        {2.0, 7.0, 3.0},  // Expected: 2.
+        {2.0, 8.0, 3.0},  // Expected: 2.
+        {2.0, 9.0, 3.0},  // Expected: 2.
+        {7.0, 7.0, 3.0},  // Expected: 3.
+        {7.0, 8.0, 3.0},  // Expected: 3.
+        {7.0, 9.0, 3.0},  // Expected: 3.
+        {7.0, 1.0, 3.0},  // Expected: 4.
+        {7.0, 2.0, 3.0},  // Expected: 4.
+    });
+    test_data.print();
+
+    std::cout << "Build and train RandomForest for classification, and save it with a per-tree index." << std::endl;
+    RandomForest rf_classification = RandomForest(training_data,num_trees,false,"gini_impurity",-1,-1,-1,-1,-1,42);
+    DataVector pred_classification = rf_classification.predict(&test_data);
+    std::cout << pred_classification << std::endl;
+    CompiledForest(rf_classification).saveIndexed("test_lazy_forest.forest");
+
+    std::cout << "Open it lazily (no tree is loaded until used):" << std::endl;
+    {
+        LazyForest lazy("test_lazy_forest.forest");
+        assert ( (lazy.getNumTrees()==num_trees) and (lazy.getNumFeatures()==3) and (!lazy.isRegressionTree()) );
+        assert (lazy.getClasses()==std::vector<double>({0, 1, 2, 3, 4, 5}));
+        assert (lazy.getNumLoadedTrees()==0);
+        lazy.predictTree(2, test_data.row(0)->data());
+        lazy.predictTree(2, test_data.row(1)->data());
+        assert (lazy.getNumLoadedTrees()==1);
+        std::vector<DecisionTree> trees = rf_classification.getTrees();
+        for (int t = 0; t < num_trees; t++)
+        {
+            assert (lazy.predictTree(t, test_data.row(3)->data())==trees[t].predict_one(test_data.row(3)->data(), test_data.width()));
+        }
+        std::cout << "Loaded trees: " << lazy.getNumLoadedTrees() << std::endl;
+        assert (lazy.predict(&test_data).vector()==pred_classification.vector());
+        assert (lazy.getNumLoadedTrees()==num_trees);
+    }
+
+    std::cout << "Prefetch all trees in the background while predicting:" << std::endl;
+    {
+        LazyForest lazy("test_lazy_forest.forest", true);
+        std::vector<double> predictions(test_data.length());
+        for (int j = 0; j < test_data.length(); j++)
+        {
+            predictions[j] = lazy.predict(test_data.row(j)->data());
+        }
+        assert (predictions==pred_classification.vector());
+        assert (lazy.getNumLoadedTrees()==num_trees);
+    }
+    {
+        LazyForest lazy("test_lazy_forest.forest");
+        lazy.prefetch(false);
+        assert (lazy.getNumLoadedTrees()==num_trees);
+    }
+
+    std::cout << "Build and train RandomForest for regression (same predictions from a buffer):" << std::endl;
+    RandomForest rf_regression = RandomForest(training_data,num_trees,true,"mean_squared_error",-1,-1,-1,-1,-1,42);
+    DataVector pred_regression = rf_regression.predict(&test_data);
+    CompiledForest(rf_regression).saveIndexed("test_lazy_forest.forest");
+    {
+        LazyForest lazy("test_lazy_forest.forest");
+        std::vector<double> buffer;
+        for (int j = 0; j < test_data.length(); j++)
+        {
+            buffer.insert(buffer.end(), test_data.row(j)->data(), test_data.row(j)->data()+test_data.width());
+        }
+        std::vector<double> predictions(test_data.length());
+        lazy.predict(buffer.data(), test_data.length(), 3, 3, predictions.data());
+        std::cout << DataVector(predictions, false) << std::endl;
+        assert (predictions==pred_regression.vector());
+    }
+
+    std::cout << "A split pointing back to its own tree is rejected when the tree is used:" << std::endl;
+    {
+        // Regression file: magic, header (4 int64), no class labels, then the index (offset of tree 0 first):
+        std::fstream file("test_lazy_forest.forest", std::ios::in | std::ios::out | std::ios::binary);
+        int64_t offset;
+        file.seekg(8+4*sizeof(int64_t));
+        file.read(reinterpret_cast<char*>(&offset), sizeof(offset));
+        int right = 0;  // Root of tree 0 (a split) goes back to itself on the right.
+        file.seekp(offset+offsetof(CompiledNode, right));
+        file.write(reinterpret_cast<const char*>(&right), sizeof(right));
+    }
+    {
+        LazyForest lazy("test_lazy_forest.forest");
+        bool rejected = false;
+        try {
+            lazy.predictTree(0, test_data.row(0)->data());
+        } catch (const std::runtime_error& error) {
+            std::cout << error.what() << std::endl;
+            rejected = true;
+        }
+        assert (rejected);
+        assert (lazy.predictTree(1, test_data.row(0)->data())==rf_regression.getTree(1).predict_one(test_data.row(0)->data(), test_data.width()));
+    }
+
+    std::cout << "Files of other formats are rejected:" << std::endl;
+    CompiledForest(rf_regression).save("test_lazy_forest.forest");
+    bool failed = false;
+    try {
+        LazyForest lazy("test_lazy_forest.forest");
+    } catch (const std::runtime_error& error) {
+        std::cout << error.what() << std::endl;
+        failed = true;
+    }
+    assert (failed);
+    std::remove("test_lazy_forest.forest");
+
+    return 0;
+};
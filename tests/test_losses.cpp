@@ -61,5 +61,14 @@ int main(){
     std::cout << "Binary cross-entropy ( -( 5/13*log2(5/13) + 8/13*log2(8/13) ) ): " + std::to_string(loss_entropy2) << std::endl;
     std::cout << std::endl;
 
+    std::cout << "Calculate loss with sample weights (test 3)." << std::endl;
+    DataVector labels3 = DataVector({1,2});
+    std::vector<int> weights3 = {5,8};
+    std::cout << labels3 << "Counts : " << LabelCounter(labels3, weights3) << std::endl;
+    double loss_entropy3 = LossFunction("cross_entropy").calculate(labels3, weights3);
+    std::cout << "Binary cross-entropy, same as test 2: " + std::to_string(loss_entropy3) << std::endl;
+    assert (loss_entropy3==loss_entropy2);
+    std::cout << std::endl;
+
     return 0;
 };
@@ -0,0 +1,87 @@
+#include <iostream>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/prediction_cache.cpp"
+
+
+int main(){
+
+    int num_trees = 10;
+
+    std::cout << "Define training data:" << std::endl;
+    DataFrame training_data = DataFrame({
+        {2.232, 2.456, 2.000, 0},
+        {2.232, 2.456, 3.000, 1},
+        {2.277, 8.735, 3.000, 2},
+        {2.965, 6.846, 3.000, 2},
+        {2.252, 6.452, 3.000, 2},
+        {2.222, 9.944, 3.000, 2},
+        {2.322, 8.747, 3.000, 2},
+        {2.322, 7.667, 3.000, 2},
+        {6.201, 6.342, 3.000, 3},
+        {6.201, 7.442, 3.000, 3},
+        {7.403, 9.944, 3.000, 3},
+        {8.720, 8.747, 3.000, 3},
+        {6.804, 9.941, 3.000, 3},
+        {6.201, 9.452, 3.000, 3},
+        {8.403, 3.944, 3.000, 4},
+        {8.403, 3.944, 4.000, 5},
+    });
+    training_data.print();
+
+    std::cout << "Define test data:" << std::endl;
+    DataFrame test_data = DataFrame({
+        {2.0, 0.0, 3.0},  // Expected: 1.
+        {2.0, 1.0, 3.0},  // Expected: 1.
+        {2.0, 2.0, 3.0},  // Expected: 1.
+        {2.0, 7.0, 3.0},  // Expected: 2.
+        {2.0, 8.0, 3.0},  // Expected: 2.
+        {2.0, 9.0, 3.0},  // Expected: 2.
+        {7.0, 7.0, 3.0},  // Expected: 3.
+        {7.0, 8.0, 3.0},  // Expected: 3.
+        {7.0, 9.0, 3.0},  // Expected: 3.
+        {7.0, 1.0, 3.0},  // Expected: 4.
+        {7.0, 2.0, 3.0},  // Expected: 4.
+    });
+    test_data.print();
+
+    std::cout << "Build and train RandomForest for classification." << std::endl;
+    RandomForest rf_classification = RandomForest(training_data,num_trees,false,"gini_impurity",-1,-1,-1,-1,-1,42);
+    DataVector pred_classification = rf_classification.predict(&test_data);
+    std::cout << pred_classification << std::endl;
+
+    std::cout << "Predict through a cache (same predictions, all misses then all hits):" << std::endl;
+    PredictionCache cache(rf_classification, 100, 4);
+    assert (cache.predict(&test_data).vector()==pred_classification.vector());
+    assert ( (cache.getHits()==0) and (cache.getMisses()==test_data.length()) );
+    assert (cache.predict(&test_data).vector()==pred_classification.vector());
+    std::cout << "Hits: " << cache.getHits() << ", misses: " << cache.getMisses() << ", size: " << cache.getSize() << std::endl;
+    assert ( (cache.getHits()==test_data.length()) and (cache.getSize()==test_data.length()) );
+
+    std::cout << "Evict least recently used predictions beyond capacity:" << std::endl;
+    PredictionCache small_cache(rf_classification, 2, 1);
+    small_cache.predict(&test_data);
+    std::cout << "Size: " << small_cache.getSize() << std::endl;
+    assert (small_cache.getSize()==2);
+    // Last two observations are still cached, the first one is not:
+    small_cache.predict(test_data.row(test_data.length()-1)->data(), test_data.width());
+    small_cache.predict(test_data.row(test_data.length()-2)->data(), test_data.width());
+    assert (small_cache.getHits()==2);
+    small_cache.predict(test_data.row(0)->data(), test_data.width());
+    assert (small_cache.getHits()==2);
+    small_cache.clear();
+    assert ( (small_cache.getSize()==0) and (small_cache.getMisses()==0) );
+
+    std::cout << "Round feature values to share predictions of nearby observations:" << std::endl;
+    PredictionCache rounded_cache(rf_classification, 100, 4, 1.0);
+    std::vector<double> observation = {2.0, 7.0, 3.0};
+    std::vector<double> nearby = {2.5, 7.5, 3.5};
+    rounded_cache.predict(observation.data(), observation.size());
+    assert (rounded_cache.predict(nearby.data(), nearby.size())==rf_classification.predict_one(observation.data(), observation.size()));
+    assert (rounded_cache.getHits()==1);
+
+    return 0;
+};
@@ -0,0 +1,125 @@
+#include <iostream>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/compiled_forest.cpp"
+#include "../src/forest_handle.cpp"
+#include "../src/prediction_server.cpp"
+
+
+int main(){
+
+    int num_trees = 10;
+
+    std::cout << "Define training data:" << std::endl;
+    DataFrame training_data = DataFrame({
+        {2.232, 2.456, 2.000, 0},
+        {2.232, 2.456, 3.000, 1},
+        {2.277, 8.735, 3.000, 2},
+        {2.965, 6.846, 3.000, 2},
+        {2.252, 6.452, 3.000, 2},
+        {2.222, 9.944, 3.000, 2},
+        {2.322, 8.747, 3.000, 2},
+        {2.322, 7.667, 3.000, 2},
+        {6.201, 6.342, 3.000, 3},
+        {6.201, 7.442, 3.000, 3},
+        {7.403, 9.944, 3.000, 3},
+        {8.720, 8.747, 3.000, 3},
+        {6.804, 9.941, 3.000, 3},
+        {6.201, 9.452, 3.000, 3},
+        {8.403, 3.944, 3.000, 4},
+        {8.403, 3.944, 4.000, 5},
+    });
+    training_data.print();
+
+    std::cout << "Define test data:" << std::endl;
+    DataFrame test_data = DataFrame({
+        {2.0, 0.0, 3.0},  // Expected: 1.
+        {2.0, 1.0, 3.0},  // Expected: 1.
+        {2.0, 2.0, 3.0},  // Expected: 1.
+        {2.0, 7.0, 3.0},  // Expected: 2.
+        {2.0, 8.0, 3.0},  // Expected: 2.
+        {2.0, 9.0, 3.0},  // Expected: 2.
+        {7.0, 7.0, 3.0},  // Expected: 3.
+        {7.0, 8.0, 3.0},  // Expected: 3.
+        {7.0, 9.0, 3.0},  // Expected: 3.
+        {7.0, 1.0, 3.0},  // Expected: 4.
+        {7.0, 2.0, 3.0},  // Expected: 4.
+    });
+    test_data.print();
+
+    std::cout << "Save and load a CompiledForest:" << std::endl;
+    RandomForest rf_classification = RandomForest(training_data,num_trees,false,"gini_impurity",-1,-1,-1,-1,-1,42);
+    CompiledForest(rf_classification).save("test_prediction_server.forest");
+    std::shared_ptr<const CompiledForest> forest = std::make_shared<const CompiledForest>(CompiledForest::load("test_prediction_server.forest"));
+    DataVector pred_classification = rf_classification.predict(&test_data);
+    std::cout << pred_classification << std::endl;
+    assert (forest->predict(&test_data).vector()==pred_classification.vector());
+
+    std::cout << "Start a PredictionServer on a Unix socket:" << std::endl;
+    PredictionServer server(forest, "test_prediction_server.sock", 2, 8, 1000);
+    server.start();
+    assert (server.isRunning());
+
+    std::cout << "Send requests from several clients at once (same predictions):" << std::endl;
+    int num_clients = 4;
+    int num_requests = 50;
+    int num_features = test_data.width();
+    std::vector<std::thread> clients;
+    for (int c = 0; c < num_clients; c++)
+    {
+        clients.emplace_back([&, c]() {
+            PredictionClient client("test_prediction_server.sock");
+            for (int k = 0; k < num_requests; k++)
+            {
+                // Requests of 1 to 3 observations:
+                int first = (c+k) % test_data.length();
+                int num_rows = std::min(1+k%3, test_data.length()-first);
+                std::vector<double> rows;
+                for (int i = first; i < first+num_rows; i++)
+                {
+                    rows.insert(rows.end(), test_data.row(i)->data(), test_data.row(i)->data()+num_features);
+                }
+                std::vector<double> predictions(num_rows);
+                client.predict(rows.data(), num_rows, num_features, predictions.data());
+                for (int i = 0; i < num_rows; i++)
+                {
+                    assert (predictions[i]==pred_classification.value(first+i));
+                }
+            }
+        });
+    }
+    for (std::thread& client : clients)
+    {
+        client.join();
+    }
+
+    ServerStats stats = server.getStats();
+    std::cout << "Requests: " << stats.requests << ", rows: " << stats.rows << ", batches: " << stats.batches << std::endl;
+    std::cout << "Latency (us): p50 " << stats.p50_us << ", p90 " << stats.p90_us << ", p99 " << stats.p99_us << std::endl;
+    assert (stats.requests==num_clients*num_requests);
+    assert (stats.batches<=stats.requests);
+    assert ( (stats.p50_us<=stats.p90_us) and (stats.p90_us<=stats.p99_us) );
+
+    std::cout << "Swap in another forest while serving:" << std::endl;
+    RandomForest rf_regression = RandomForest(training_data,num_trees,true,"mean_squared_error",-1,-1,-1,-1,-1,42);
+    DataVector pred_regression = rf_regression.predict(&test_data);
+    std::shared_ptr<const CompiledForest> previous = server.swapForest(std::make_shared<const CompiledForest>(rf_regression));
+    assert (previous==forest);
+    {
+        PredictionClient client("test_prediction_server.sock");
+        std::vector<double> predictions(1);
+        client.predict(test_data.row(0)->data(), 1, num_features, predictions.data());
+        assert (predictions[0]==pred_regression.value(0));
+    }
+
+    std::cout << "Stop the server (with a connection still open):" << std::endl;
+    PredictionClient idle_client("test_prediction_server.sock");
+    server.stop();
+    assert (!server.isRunning());
+    std::remove("test_prediction_server.forest");
+
+    return 0;
+};
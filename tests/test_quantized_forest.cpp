@@ -0,0 +1,99 @@
+#include <iostream>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/quantized_forest.cpp"
+
+
+int main(){
+
+    int num_trees = 10;
+
+    std::cout << "Define training data:" << std::endl;
+    DataFrame training_data = DataFrame({
+        {2.232, 2.456, 2.000, 0},
+        {2.232, 2.456, 3.000, 1},
+        {2.277, 8.735, 3.000, 2},
+        {2.965, 6.846, 3.000, 2},
+        {2.252, 6.452, 3.000, 2},
+        {2.222, 9.944, 3.000, 2},
+        {2.322, 8.747, 3.000, 2},
+        {2.322, 7.667, 3.000, 2},
+        {6.201, 6.342, 3.000, 3},
+        {6.201, 7.442, 3.000, 3},
+        {7.403, 9.944, 3.000, 3},
+        {8.720, 8.747, 3.000, 3},
+        {6.804, 9.941, 3.000, 3},
+        {6.201, 9.452, 3.000, 3},
+        {8.403, 3.944, 3.000, 4},
+        {8.403, 3.944, 4.000, 5},
+    });
+    training_data.print();
+
+    std::cout << "Define test data:" << std::endl;
+    DataFrame test_data = DataFrame({
+        {2.0, 0.0, 3.0},  // Expected: 1.
+        {2.0, 1.0, 3.0},  // Expected: 1.
+        {2.0, 2.0, 3.0},  // Expected: 1.
+        {2.0, 7.0, 3.0},  // Expected: 2.
+        {2.0, 8.0, 3.0},  // Expected: 2.
+        {2.0, 9.0, 3.0},  // Expected: 2.
+        {7.0, 7.0, 3.0},  // Expected: 3.
+        {7.0, 8.0, 3.0},  // Expected: 3.
+        {7.0, 9.0, 3.0},  // Expected: 3.
+        {7.0, 1.0, 3.0},  // Expected: 4.
+        {7.0, 2.0, 3.0},  // Expected: 4.
+    });
+    test_data.print();
+
+    std::cout << "Quantize a DecisionTree:" << std::endl;
+    DecisionTree tree = DecisionTree(training_data,false,"gini_impurity",-1,-1,-1,-1,-1);
+    QuantizedForest quantized_tree = QuantizedForest(tree);
+    std::cout << "Number of nodes: " << quantized_tree.getNumNodes() << std::endl;
+    assert (quantized_tree.getNumNodes()==tree.getSize());
+    DataVector pred_tree = quantized_tree.predict(&test_data);
+    std::cout << pred_tree << std::endl;
+    assert (pred_tree.vector()==tree.predict(&test_data).vector());
+
+    std::cout << "Quantize a RandomForest for classification:" << std::endl;
+    RandomForest rf_classification = RandomForest(training_data,num_trees,false,"gini_impurity",-1,-1,-1,-1,-1,42);
+    QuantizedForest quantized_classification = QuantizedForest(rf_classification);
+    std::cout << "Model size: " << quantized_classification.getModelBytes() << " bytes" << std::endl;
+    std::cout << "Thresholds of feature 0: ";
+    for (double threshold : quantized_classification.getThresholds(0)){ std::cout << threshold << " "; }
+    std::cout << std::endl;
+    DataVector pred_classification = quantized_classification.predict(&test_data);
+    std::cout << pred_classification << std::endl;
+    assert (pred_classification.vector()==rf_classification.predict(&test_data).vector());
+
+    std::cout << "Quantize a RandomForest for regression:" << std::endl;
+    RandomForest rf_regression = RandomForest(training_data,num_trees,true,"mean_squared_error",-1,-1,-1,-1,-1,42);
+    QuantizedForest quantized_regression = QuantizedForest(rf_regression);
+    DataVector pred_regression = quantized_regression.predict(&test_data);
+    std::cout << pred_regression << std::endl;
+    assert (pred_regression.vector()==rf_regression.predict(&test_data).vector());
+
+    std::cout << "Predict in blocks of 4 observations and from encoded values (same predictions):" << std::endl;
+    quantized_regression.setBlockSize(4);
+    assert (quantized_regression.predict(&test_data).vector()==pred_regression.vector());
+    std::vector<uint16_t> bins(quantized_regression.getNumFeatures());
+    for (int i = 0; i < test_data.length(); i++)
+    {
+        quantized_regression.encode(test_data.row(i)->data(), test_data.width(), bins.data());
+        assert (quantized_regression.predictEncoded(bins.data())==pred_regression.value(i));
+        assert (quantized_regression.predict(test_data.row(i)->data(), test_data.width())==pred_regression.value(i));
+    }
+
+    std::cout << "Encode thresholds and missing values:" << std::endl;
+    std::vector<double> thresholds = quantized_regression.getThresholds(0);
+    std::vector<double> observation = {thresholds.back(), NAN, 3.0};
+    quantized_regression.encode(observation.data(), observation.size(), bins.data());
+    std::cout << bins[0] << " " << bins[1] << std::endl;
+    assert (bins[0]==thresholds.size()-1);  // Value equal to the last threshold goes left at that split.
+    assert (bins[1]==quantized_regression.getThresholds(1).size());  // Missing values go right everywhere.
+    assert (quantized_regression.predict(observation.data(), observation.size())==rf_regression.predict_one(observation.data(), observation.size()));
+
+    return 0;
+};
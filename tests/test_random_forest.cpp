@@ -61,5 +61,205 @@ int main(){
     DataVector pred_regression = rf_regression.predict(&test_data);
     std::cout << pred_regression << std::endl;
 
+    std::cout << "Predict in blocks of 4 observations (same predictions):" << std::endl;
+    rf_regression.setBlockSize(4);
+    assert (rf_regression.predict(&test_data).vector()==pred_regression.vector());
+    rf_classification.setBlockSize(4);
+    assert (rf_classification.predict(&test_data).vector()==pred_classification.vector());
+
+    std::cout << "Predict single observations from raw values (same predictions):" << std::endl;
+    std::vector<double> votes(rf_classification.getClasses().size());
+    for (int i = 0; i < test_data.length(); i++)
+    {
+        const double* features = test_data.row(i)->data();
+        double output;
+        rf_classification.predict_one(features, test_data.width(), &output, votes.data());
+        assert (output==pred_classification.value(i));
+        assert (rf_classification.predict_one(features, test_data.width())==pred_classification.value(i));
+        assert (rf_regression.predict_one(features, test_data.width())==pred_regression.value(i));
+    }
+    std::cout << "Votes for last observation: ";
+    for (double vote : votes){ std::cout << vote << " "; }
+    std::cout << std::endl;
+
+    std::cout << "Predict from external buffers (row-major doubles and column-major floats):" << std::endl;
+    size_t num_rows = test_data.length();
+    size_t num_features = test_data.width();
+    std::vector<double> row_major(num_rows*num_features);
+    std::vector<float> col_major(num_rows*num_features);
+    for (size_t r = 0; r < num_rows; r++)
+    {
+        for (size_t f = 0; f < num_features; f++)
+        {
+            row_major[r*num_features+f] = test_data.value(r, f);
+            col_major[f*num_rows+r] = test_data.value(r, f);
+        }
+    }
+    std::vector<double> output(num_rows);
+    rf_classification.predict(row_major.data(), num_rows, num_features, num_features, 1, output.data());
+    assert (output==pred_classification.vector());
+    rf_regression.predict(col_major.data(), num_rows, num_features, 1, num_rows, output.data());
+    std::cout << DataVector(output, false) << std::endl;
+    assert (output==pred_regression.vector());
+    rf_classification.getTree(0).predict(col_major.data(), num_rows, num_features, 1, num_rows, output.data());
+    assert (output==rf_classification.getTree(0).predict(&test_data).vector());
+
+    std::cout << "Predict class probabilities:" << std::endl;
+    DataFrame probabilities = rf_classification.predict_proba(&test_data);
+    probabilities.print();
+    for (int i = 0; i < test_data.length(); i++)
+    {
+        // Probabilities add up to one:
+        assert (std::abs(probabilities.row(i)->sum()-1)<1e-9);
+    }
+    size_t num_classes = rf_classification.getClasses().size();
+    std::vector<double> proba_output(num_rows*num_classes);
+    rf_classification.predict_proba(row_major.data(), num_rows, num_features, num_features, 1, proba_output.data());
+    for (size_t r = 0; r < num_rows; r++)
+    {
+        for (size_t c = 0; c < num_classes; c++)
+        {
+            assert (proba_output[r*num_classes+c]==probabilities.value(r, c));
+        }
+    }
+
+    std::cout << "Predict with early exit once the majority is decided (same predictions):" << std::endl;
+    rf_classification.setEarlyExit(true);
+    assert (rf_classification.predict(&test_data).vector()==pred_classification.vector());
+    rf_classification.predict(row_major.data(), num_rows, num_features, num_features, 1, output.data());
+    assert (output==pred_classification.vector());
+    for (int i = 0; i < test_data.length(); i++)
+    {
+        assert (rf_classification.predict_one(test_data.row(i)->data(), test_data.width())==pred_classification.value(i));
+    }
+    rf_classification.setEarlyExit(false);
+
+    std::cout << "Predict with a budget (trees ordered by out-of-bag score):" << std::endl;
+    std::vector<int> order = rf_classification.getTreeOrder();
+    for (int i : order){ std::cout << i << " "; }
+    std::cout << std::endl;
+    std::sort(order.begin(), order.end());
+    for (int i = 0; i < num_trees; i++){ assert (order[i]==i); }
+    int trees_used;
+    assert (rf_classification.predictWithBudget(&test_data, -1, -1, &trees_used).vector()==pred_classification.vector());
+    assert (trees_used==num_trees);
+    DataVector pred_budget = rf_regression.predictWithBudget(&test_data, 2, -1, &trees_used);
+    assert (trees_used==2);
+    for (int i = 0; i < test_data.length(); i++)
+    {
+        double output;
+        assert (rf_regression.predictWithBudget(test_data.row(i)->data(), test_data.width(), &output, 2)==2);
+        assert (output==pred_budget.value(i));
+        assert (rf_regression.predictWithBudget(test_data.row(i)->data(), test_data.width(), &output, -1)==num_trees);
+        assert (std::abs(output-pred_regression.value(i))<1e-9);
+        // An exhausted time budget still evaluates one tree:
+        assert (rf_classification.predictWithBudget(test_data.row(i)->data(), test_data.width(), &output, -1, 0)==1);
+    }
+
+    std::cout << "Build and train RandomForest for classification (presorted split search)." << std::endl;
+    RandomForest rf_presorted = RandomForest(training_data,num_trees,false,"gini_impurity",-1,-1,-1,-1,-1,42,"presorted");
+    RandomForest rf_exact = RandomForest(training_data,num_trees,false,"gini_impurity",-1,-1,-1,-1,-1,42,"exact");
+    DataVector pred_presorted = rf_presorted.predict(&test_data);
+    std::cout << pred_presorted << std::endl;
+    assert (pred_presorted.vector()==rf_exact.predict(&test_data).vector());
+
+    std::cout << "Build and train RandomForest for classification (histogram split search)." << std::endl;
+    RandomForest rf_histogram = RandomForest(training_data,num_trees,false,"gini_impurity",-1,-1,-1,-1,-1,42,"histogram");
+    std::cout << rf_histogram.predict(&test_data) << std::endl;
+
+    std::cout << "Build and train RandomForest for classification (half-size subsamples without replacement)." << std::endl;
+    RandomForest rf_subsample = RandomForest(training_data,num_trees,false,"gini_impurity",-1,-1,-1,-1,-1,42,"exact",0.5,false);
+    std::cout << "Rows per tree: " << rf_subsample.getNumSamples() << std::endl;
+    assert (rf_subsample.getNumSamples()==8);
+    std::cout << rf_subsample.predict(&test_data) << std::endl;
+
+    std::cout << "Compact forests (same predictions with fewer nodes):" << std::endl;
+    RandomForest rf_compact = RandomForest(training_data,num_trees,false,"gini_impurity",-1,4,-1,-1,-1,42);
+    DataVector pred_compact = rf_compact.predict(&test_data);
+    CompactionStats merged = rf_compact.compact(true, false);
+    DataFrame proba_merged = rf_compact.predict_proba(&test_data);
+    CompactionStats shared = rf_compact.compact(false, true);
+    std::cout << "Nodes: " << merged.nodes_before << ", merged: " << merged.merged_nodes << ", shared: " << shared.shared_nodes
+              << ", after: " << shared.nodes_after << std::endl;
+    assert (merged.nodes_after==merged.nodes_before-merged.merged_nodes);
+    assert (shared.nodes_after==merged.nodes_after-shared.shared_nodes);
+    assert ( (merged.merged_nodes>0) and (shared.shared_nodes>0) and (shared.nodes_after==rf_compact.getNumNodes()) );
+    assert (rf_compact.predict(&test_data).vector()==pred_compact.vector());
+    for (int i = 0; i < test_data.length(); i++)
+    {
+        assert (rf_compact.predict_proba(&test_data).row(i)->vector()==proba_merged.row(i)->vector());
+    }
+    CompactionStats again = rf_compact.compact();  // Nothing left to remove (and shared nodes are not deleted).
+    assert ( (again.merged_nodes==0) and (again.shared_nodes==0) and (again.nodes_after==shared.nodes_after) );
+    assert (rf_compact.predict(&test_data).vector()==pred_compact.vector());
+    RandomForest rf_compact_regression = RandomForest(training_data,num_trees,true,"mean_squared_error",-1,-1,-1,-1,-1,42);
+    DataVector pred_compact_regression = rf_compact_regression.predict(&test_data);
+    CompactionStats stats = rf_compact_regression.compact(false, true);  // Sharing first: leaves merged afterwards may be shared between trees.
+    assert (stats.nodes_after<stats.nodes_before);
+    assert (rf_compact_regression.compact().nodes_after<=stats.nodes_after);
+    assert (rf_compact_regression.predict(&test_data).vector()==pred_compact_regression.vector());
+
+    std::cout << "Copies of a forest and of its trees (taken before compaction) stay valid after compacting it:" << std::endl;
+    DataFrame hmeq_data = DataLoader("../data/hmeq_clean.csv").load();
+    RandomForest rf_stumps = RandomForest(hmeq_data,20,false,"gini_impurity",-1,1,-1,-1,-1,42);
+    std::vector<double> pred_stumps = rf_stumps.predict(&hmeq_data).vector();
+    std::vector<DecisionTree> stump_trees = rf_stumps.getTrees();
+    DecisionTree first_stump = rf_stumps.getTree(0);
+    RandomForest rf_stumps_copy = rf_stumps;
+    RandomForest rf_stumps_assigned = rf_compact;
+    rf_stumps_assigned = rf_stumps;
+    std::vector<std::vector<double>> pred_stump_trees;
+    std::vector<int> stump_sizes;
+    for (DecisionTree& tree : stump_trees)
+    {
+        pred_stump_trees.push_back(tree.predict(&hmeq_data).vector());
+        stump_sizes.push_back(tree.getLeaves().size());
+    }
+    CompactionStats stump_stats = rf_stumps.compact();
+    std::cout << "Nodes: " << stump_stats.nodes_before << ", after: " << stump_stats.nodes_after << std::endl;
+    assert (stump_stats.nodes_after<stump_stats.nodes_before);
+    for (int t = 0; t < stump_trees.size(); t++)
+    {
+        assert (stump_trees[t].predict(&hmeq_data).vector()==pred_stump_trees[t]);
+        assert (stump_trees[t].predict_one(hmeq_data.row(0)->data(), hmeq_data.width())==pred_stump_trees[t][0]);
+        assert (stump_trees[t].getLeaves().size()==stump_sizes[t]);
+    }
+    assert (first_stump.predict(&hmeq_data).vector()==pred_stump_trees[0]);
+    for (RandomForest* copy : {&rf_stumps_copy, &rf_stumps_assigned})
+    {
+        assert (copy->getNumNodes()==stump_stats.nodes_before);
+        assert (copy->predict(&hmeq_data).vector()==pred_stumps);
+        assert (copy->compact().nodes_after==stump_stats.nodes_after);  // Compacting the copy leaves the original unchanged.
+        assert (copy->predict(&hmeq_data).vector()==pred_stumps);
+    }
+    assert (rf_stumps.predict(&hmeq_data).vector()==pred_stumps);
+
+    std::cout << "Select trees greedily on validation data (here, the training data), and prune forests:" << std::endl;
+    std::vector<double> scores;
+    std::vector<int> selection = rf_classification.selectTrees(&training_data, &scores);
+    for (int i = 0; i < num_trees; i++){ std::cout << selection[i] << " (" << scores[i] << ") "; }
+    std::cout << std::endl;
+    std::vector<int> sorted_selection = selection;
+    std::sort(sorted_selection.begin(), sorted_selection.end());
+    for (int i = 0; i < num_trees; i++){ assert (sorted_selection[i]==i); }
+    RandomForest rf_pruned = rf_classification.prune(&training_data, 3);
+    assert (rf_pruned.getNumTrees()==3);
+    DataVector pred_pruned = rf_pruned.predict(&training_data);
+    int correct = 0;
+    for (int i = 0; i < training_data.length(); i++){ correct += (pred_pruned.value(i)==training_data.value(i, -1)); }
+    assert (double(correct)/training_data.length()==scores[2]);
+    RandomForest rf_best = rf_classification.prune(&training_data);
+    std::cout << "Trees kept: " << rf_best.getNumTrees() << std::endl;
+    assert (scores[rf_best.getNumTrees()-1]==*std::max_element(scores.begin(), scores.end()));
+    std::vector<int> pruned_order = rf_best.getTreeOrder();
+    assert (pruned_order.size()==rf_best.getNumTrees());
+    RandomForest rf_pruned_regression = rf_regression.prune(&training_data, 2);
+    assert ( (rf_pruned_regression.getNumTrees()==2) and (rf_pruned_regression.predict(&test_data).size()==test_data.length()) );
+    int num_nodes_before_pruning = rf_classification.getNumNodes();
+    CompactionStats pruned_stats = rf_classification.prune(&training_data).compact();  // Leaves the original forest unchanged.
+    std::cout << "Nodes of pruned forest: " << pruned_stats.nodes_before << ", after compaction: " << pruned_stats.nodes_after << std::endl;
+    assert (rf_classification.getNumNodes()==num_nodes_before_pruning);
+    assert (rf_classification.predict(&test_data).vector()==pred_classification.vector());
+
     return 0;
 };
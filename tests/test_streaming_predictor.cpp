@@ -0,0 +1,94 @@
+#include <iostream>
+#include <sstream>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/compiled_forest.cpp"
+#include "../src/streaming_predictor.cpp"
+
+
+int main(){
+
+    int num_trees = 10;
+
+    std::cout << "Define training data:" << std::endl;
+    DataFrame training_data = DataFrame({
+        {2.232, 2.456, 2.000, 0},
+        {2.232, 2.456, 3.000, 1},
+        {2.277, 8.735, 3.000, 2},
+        {2.965, 6.846, 3.000, 2},
+        {2.252, 6.452, 3.000, 2},
+        {2.222, 9.944, 3.000, 2},
+        {2.322, 8.747, 3.000, 2},
+        {2.322, 7.667, 3.000, 2},
+        {6.201, 6.342, 3.000, 3},
+        {6.201, 7.442, 3.000, 3},
+        {7.403, 9.944, 3.000, 3},
+        {8.720, 8.747, 3.000, 3},
+        {6.804, 9.941, 3.000, 3},
+        {6.201, 9.452, 3.000, 3},
+        {8.403, 3.944, 3.000, 4},
+        {8.403, 3.944, 4.000, 5},
+    });
+    training_data.print();
+
+    std::cout << "Build and train RandomForest for regression, and compile it." << std::endl;
+    RandomForest rf_regression = RandomForest(training_data,num_trees,true,"mean_squared_error",-1,-1,-1,-1,-1,42);
+    CompiledForest compiled = CompiledForest(rf_regression);
+
+    std::cout << "Write many observations as CSV (with labels on even lines, blank lines and a missing last newline):" << std::endl;
+    std::vector<std::vector<double>> rows;
+    std::ostringstream input;
+    int num_rows = 500;
+    for (int j = 0; j < num_rows; j++)
+    {
+        std::vector<double> row = {(j%91)/10.0, (j%97)/10.0, 2.0+(j%3)};
+        rows.push_back(row);
+        input << row[0] << "," << row[1] << "," << row[2];
+        if (j%2==0) { input << "," << j%5; }
+        if (j%50==0) { input << "\n"; }
+        if (j<num_rows-1) { input << "\n"; }
+    }
+    DataFrame test_data = DataFrame(rows);
+    DataVector expected = rf_regression.predict(&test_data);
+
+    std::cout << "Score in small chunks (lines span chunk boundaries) with a small memory budget:" << std::endl;
+    StreamingPredictor streaming(compiled, 3, 64, 1000);
+    std::cout << "Chunks in flight: " << streaming.getMaxChunks() << std::endl;
+    assert (streaming.getMaxChunks()==5);
+    std::istringstream input_stream(input.str());
+    std::ostringstream output;
+    assert (streaming.run(input_stream, output)==num_rows);
+    std::istringstream output_stream(output.str());
+    double prediction;
+    int count = 0;
+    while (output_stream >> prediction)
+    {
+        assert (prediction==expected.vector()[count]);
+        count++;
+    }
+    std::cout << "Rows written: " << count << std::endl;
+    assert (count==num_rows);
+
+    std::cout << "Empty input writes nothing:" << std::endl;
+    std::istringstream empty_stream("");
+    std::ostringstream empty_output;
+    assert (streaming.run(empty_stream, empty_output)==0);
+    assert (empty_output.str().size()==0);
+
+    std::cout << "A line with the wrong number of values stops the pipeline with an error:" << std::endl;
+    std::istringstream bad_stream(input.str()+"\n1.0,2.0\n"+input.str());
+    std::ostringstream bad_output;
+    bool failed = false;
+    try {
+        streaming.run(bad_stream, bad_output);
+    } catch (const std::invalid_argument& error) {
+        std::cout << error.what() << std::endl;
+        failed = true;
+    }
+    assert (failed);
+
+    return 0;
+};
@@ -0,0 +1,45 @@
+#include <iostream>
+#include <fstream>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/code_generator.cpp"
+
+/**
+ * Fit a RandomForest on a CSV file (labels in the last column) and write standalone C++ scoring code for it.
+ * Usage:
+ *    ./forest_codegen <data.csv> <output.cpp> [num_trees=10] [max_height=-1] [regression=0] [seed=42] [function_name=predict]
+ * The output can be built into a shared object with no dependency on this library, e.g.:
+ *    g++ -O2 -shared -fPIC output.cpp -o libmodel.so
+ **/
+int main(int argc, char** argv){
+    if (argc<3) {
+        std::cout << "Usage: " << argv[0] << " <data.csv> <output.cpp> [num_trees=10] [max_height=-1] [regression=0] [seed=42] [function_name=predict]" << std::endl;
+        return 1;
+    }
+    std::string data_path = argv[1];
+    std::string output_path = argv[2];
+    int num_trees = (argc>3) ? std::stoi(argv[3]) : 10;
+    int max_height = (argc>4) ? std::stoi(argv[4]) : -1;
+    bool regression = (argc>5) ? (std::stoi(argv[5])!=0) : false;
+    int seed = (argc>6) ? std::stoi(argv[6]) : 42;
+    std::string function_name = (argc>7) ? argv[7] : "predict";
+
+    std::cout << "Load dataset: " << data_path << std::endl;
+    DataLoader csv_loader = DataLoader(data_path);
+    DataFrame dataframe = csv_loader.load();
+    std::cout << "Rows: " << dataframe.length() << ", Cols: " << dataframe.width() << std::endl;
+
+    std::cout << "Fit RandomForest with " << num_trees << " trees." << std::endl;
+    std::string loss = regression ? "mean_squared_error" : "gini_impurity";
+    RandomForest forest = RandomForest(dataframe,num_trees,regression,loss,-1,max_height,-1,-1,-1,seed);
+
+    std::cout << "Write scoring code: " << output_path << std::endl;
+    std::ofstream output(output_path);
+    output << generate_cpp(forest, function_name);
+    output.close();
+
+    return 0;
+};
@@ -0,0 +1,48 @@
+#include <iostream>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/compiled_forest.cpp"
+
+/**
+ * Fit a RandomForest on a CSV file (labels in the last column) and save it as a CompiledForest file,
+ * e.g. to be served by forest_server (or, with indexed=1, with a per-tree index to be opened by LazyForest).
+ * Usage:
+ *    ./forest_compile <data.csv> <output.forest> [num_trees=10] [max_height=-1] [regression=0] [seed=42] [engine=traversal] [indexed=0]
+ **/
+int main(int argc, char** argv){
+    if (argc<3) {
+        std::cout << "Usage: " << argv[0] << " <data.csv> <output.forest> [num_trees=10] [max_height=-1] [regression=0] [seed=42] [engine=traversal] [indexed=0]" << std::endl;
+        return 1;
+    }
+    std::string data_path = argv[1];
+    std::string output_path = argv[2];
+    int num_trees = (argc>3) ? std::stoi(argv[3]) : 10;
+    int max_height = (argc>4) ? std::stoi(argv[4]) : -1;
+    bool regression = (argc>5) ? (std::stoi(argv[5])!=0) : false;
+    int seed = (argc>6) ? std::stoi(argv[6]) : 42;
+    std::string engine = (argc>7) ? argv[7] : "traversal";
+    bool indexed = (argc>8) ? (std::stoi(argv[8])!=0) : false;
+
+    std::cout << "Load dataset: " << data_path << std::endl;
+    DataLoader csv_loader = DataLoader(data_path);
+    DataFrame dataframe = csv_loader.load();
+    std::cout << "Rows: " << dataframe.length() << ", Cols: " << dataframe.width() << std::endl;
+
+    std::cout << "Fit RandomForest with " << num_trees << " trees." << std::endl;
+    std::string loss = regression ? "mean_squared_error" : "gini_impurity";
+    RandomForest forest = RandomForest(dataframe,num_trees,regression,loss,-1,max_height,-1,-1,-1,seed);
+
+    std::cout << "Save compiled forest: " << output_path << std::endl;
+    CompiledForest compiled = CompiledForest(forest, engine);
+    if (indexed) {
+        compiled.saveIndexed(output_path);
+    } else {
+        compiled.save(output_path);
+    }
+    std::cout << "Nodes: " << compiled.getNumNodes() << std::endl;
+
+    return 0;
+};
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <cmath>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/compiled_forest.cpp"
+#include "../src/forest_handle.cpp"
+#include "../src/prediction_server.cpp"
+
+/**
+ * Load generator for forest_server: several clients send requests made of rows of a CSV file (labels in the
+ * last column are not sent), each one waiting for its response before sending the next, and report
+ * throughput and latency percentiles seen by the clients.
+ * Usage:
+ *    ./forest_loadgen <address> <data.csv> [num_clients=4] [requests_per_client=1000] [rows_per_request=1]
+ **/
+int main(int argc, char** argv){
+    if (argc<3) {
+        std::cout << "Usage: " << argv[0] << " <address> <data.csv> [num_clients=4] [requests_per_client=1000] [rows_per_request=1]" << std::endl;
+        return 1;
+    }
+    std::string address = argv[1];
+    std::string data_path = argv[2];
+    int num_clients = (argc>3) ? std::stoi(argv[3]) : 4;
+    int num_requests = (argc>4) ? std::stoi(argv[4]) : 1000;
+    int rows_per_request = (argc>5) ? std::stoi(argv[5]) : 1;
+
+    std::cout << "Load dataset: " << data_path << std::endl;
+    DataLoader csv_loader = DataLoader(data_path);
+    DataFrame dataframe = csv_loader.load();
+    int num_rows = dataframe.length();
+    int num_features = dataframe.width()-1;  // Number of columns, excluding label column.
+    std::vector<double> features;
+    for (int j = 0; j < num_rows; j++)
+    {
+        features.insert(features.end(), dataframe.row(j)->data(), dataframe.row(j)->data()+num_features);
+    }
+
+    std::cout << "Send " << num_requests << " requests of " << rows_per_request << " rows from each of " << num_clients << " clients." << std::endl;
+    std::vector<std::vector<double>> latencies(num_clients);
+    std::vector<std::thread> clients;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int c = 0; c < num_clients; c++)
+    {
+        clients.emplace_back([&, c]() {
+            PredictionClient client(address);
+            std::vector<double> rows(rows_per_request*num_features);
+            std::vector<double> predictions(rows_per_request);
+            for (int k = 0; k < num_requests; k++)
+            {
+                // Consecutive rows of the dataset (wrapping around), different for each client:
+                for (int i = 0; i < rows_per_request; i++)
+                {
+                    int j = (size_t(c)*num_requests*rows_per_request + size_t(k)*rows_per_request + i) % num_rows;
+                    std::copy(features.begin()+size_t(j)*num_features, features.begin()+size_t(j+1)*num_features, rows.begin()+i*num_features);
+                }
+                std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+                client.predict(rows.data(), rows_per_request, num_features, predictions.data());
+                latencies[c].push_back(std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now()-sent).count());
+            }
+        });
+    }
+    for (std::thread& client : clients)
+    {
+        client.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+    std::vector<double> all_latencies;
+    for (const std::vector<double>& client_latencies : latencies)
+    {
+        all_latencies.insert(all_latencies.end(), client_latencies.begin(), client_latencies.end());
+    }
+    std::sort(all_latencies.begin(), all_latencies.end());
+    auto percentile = [&all_latencies](double p) {
+        int rank = std::ceil(p*all_latencies.size());
+        return all_latencies[std::max(rank, 1)-1];
+    };
+    long total_requests = long(num_clients)*num_requests;
+    std::cout << "Seconds: " << seconds << std::endl;
+    std::cout << "Requests/s: " << total_requests/seconds << ", rows/s: " << total_requests*rows_per_request/seconds << std::endl;
+    std::cout << "Latency (us): p50 " << percentile(0.50) << ", p90 " << percentile(0.90) << ", p99 " << percentile(0.99) << ", max " << all_latencies.back() << std::endl;
+
+    return 0;
+};
@@ -0,0 +1,41 @@
+#include <chrono>
+#include <iostream>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/compiled_forest.cpp"
+#include "../src/streaming_predictor.cpp"
+
+/**
+ * Score a CSV file (of any size) with a saved CompiledForest, writing one prediction per line in input order.
+ * Reading, scoring and writing overlap, and at most about memory_mb of the file is held in memory at once.
+ * Usage:
+ *    ./forest_score <model.forest> <input.csv> <output.csv> [num_threads=2] [chunk_kb=1024] [memory_mb=64]
+ **/
+int main(int argc, char** argv){
+    if (argc<4) {
+        std::cout << "Usage: " << argv[0] << " <model.forest> <input.csv> <output.csv> [num_threads=2] [chunk_kb=1024] [memory_mb=64]" << std::endl;
+        return 1;
+    }
+    std::string model_path = argv[1];
+    std::string input_path = argv[2];
+    std::string output_path = argv[3];
+    int num_threads = (argc>4) ? std::stoi(argv[4]) : 2;
+    size_t chunk_bytes = (argc>5) ? std::stoul(argv[5])<<10 : 1<<20;
+    size_t memory_budget = (argc>6) ? std::stoul(argv[6])<<20 : 64<<20;
+
+    std::cout << "Load compiled forest: " << model_path << std::endl;
+    CompiledForest compiled = CompiledForest::load(model_path);
+
+    StreamingPredictor streaming(compiled, num_threads, chunk_bytes, memory_budget);
+    std::cout << "Score " << input_path << " with " << num_threads << " threads, "
+              << streaming.getMaxChunks() << " chunks in flight." << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    long num_rows = streaming.run(input_path, output_path);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    std::cout << "Rows: " << num_rows << ", seconds: " << seconds << ", rows/s: " << num_rows/seconds << std::endl;
+
+    return 0;
+};
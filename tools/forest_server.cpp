@@ -0,0 +1,62 @@
+#include <iostream>
+#include <signal.h>
+#include "../src/datasets.cpp"
+#include "../src/losses.cpp"
+#include "../src/tree_node.cpp"
+#include "../src/decision_tree.cpp"
+#include "../src/random_forest.cpp"
+#include "../src/compiled_forest.cpp"
+#include "../src/forest_handle.cpp"
+#include "../src/prediction_server.cpp"
+
+/**
+ * Serve predictions of a saved CompiledForest (see forest_compile) over a Unix socket (or "tcp:<port>" on loopback),
+ * coalescing concurrent requests into micro-batches. Throughput and latency percentiles are reported every
+ * report_seconds, and once more when stopped with Ctrl-C (SIGINT) or SIGTERM.
+ * Usage:
+ *    ./forest_server <model.forest> <address> [num_threads=2] [max_batch_rows=256] [max_wait_us=200] [report_seconds=5]
+ **/
+static void report(const ServerStats& stats){
+    /** Print counters, throughput and latency percentiles. */
+    std::cout << "requests " << stats.requests << "  rows " << stats.rows << "  batches " << stats.batches
+              << "  rows/s " << ( (stats.seconds>0) ? stats.rows/stats.seconds : 0 )
+              << "  latency_us p50 " << stats.p50_us << " p90 " << stats.p90_us << " p99 " << stats.p99_us << std::endl;
+}
+
+int main(int argc, char** argv){
+    if (argc<3) {
+        std::cout << "Usage: " << argv[0] << " <model.forest> <address> [num_threads=2] [max_batch_rows=256] [max_wait_us=200] [report_seconds=5]" << std::endl;
+        return 1;
+    }
+    std::string model_path = argv[1];
+    std::string address = argv[2];
+    int num_threads = (argc>3) ? std::stoi(argv[3]) : 2;
+    int max_batch_rows = (argc>4) ? std::stoi(argv[4]) : 256;
+    int max_wait_us = (argc>5) ? std::stoi(argv[5]) : 200;
+    int report_seconds = (argc>6) ? std::stoi(argv[6]) : 5;
+
+    std::cout << "Load compiled forest: " << model_path << std::endl;
+    std::shared_ptr<const CompiledForest> forest = std::make_shared<const CompiledForest>(CompiledForest::load(model_path));
+    std::cout << "Trees: " << forest->getNumTrees() << ", features: " << forest->getNumFeatures() << std::endl;
+
+    // Block stop signals in every thread, and wait for them here:
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    PredictionServer server(forest, address, num_threads, max_batch_rows, max_wait_us);
+    server.start();
+    std::cout << "Listening on " << address << std::endl;
+    timespec timeout = {report_seconds, 0};
+    while (sigtimedwait(&signals, nullptr, &timeout)<0)
+    {
+        report(server.getStats());
+    }
+    server.stop();
+    std::cout << "Stopped." << std::endl;
+    report(server.getStats());
+
+    return 0;
+};